@@ -0,0 +1,281 @@
+// Host microbenchmarks of the bitui primitives.
+//
+// Every primitive is called in a loop on a framebuffer the size of the
+// dashboard's panel, at positions that change on every call so that all byte
+// alignments get their share. BITUI_ROTATION builds go through the 4
+// rotations, BITUI_SWAP_XY builds use the device's layout.
+//
+// Reports the time per call and the throughput in pixels covered per second.
+// `--rv32 MHZ:SLOWDOWN` adds a rough cycle count for the device: the host
+// time multiplied by SLOWDOWN (how much slower the device runs the same code,
+// measure it once against the device), at MHZ.
+//
+// Usage: bench_<layout> [--ms MILLISECONDS] [--rv32 MHZ:SLOWDOWN] [primitive...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bitui.h"
+#define PROGMEM
+#include "gfxfont.h"
+#include "DigitalDisco16pt7b.h"
+#include "DigitalDisco16pt7bRuns.h"
+
+// Size of the dashboard's panel (see components/gui/include/gui.h)
+#define PANEL_COLS 168
+#define PANEL_ROWS 384
+#define PANEL_STRIDE ((PANEL_COLS - 1) / 8 + 1)
+
+static uint8_t framebuffer[PANEL_STRIDE * PANEL_ROWS] __attribute__((aligned(4)));
+static uint8_t sprite[32 * 32 / 8];
+// A shallow sparkline like the graphs', 4 pixels between points
+#define SPARKLINE_POINTS 33
+static bitui_point_t sparkline[SPARKLINE_POINTS];
+static const char text[] = "Hello, world 12:34";
+
+typedef struct {
+    const char *name;
+    uint16_t w, h; // Size of the area covered by a call
+    void (*run)(bitui_t ctx, uint16_t x, uint16_t y);
+} bench_t;
+
+static void run_clear(bitui_t ctx, uint16_t x, uint16_t y) {
+    bitui_clear(ctx, (x ^ y) & 1);
+}
+
+static void run_hline(bitui_t ctx, uint16_t x, uint16_t y) {
+    bitui_hline(ctx, y, x, x + 99);
+}
+
+static void run_vline(bitui_t ctx, uint16_t x, uint16_t y) {
+    bitui_vline(ctx, x, y, y + 99);
+}
+
+static void run_line(bitui_t ctx, uint16_t x, uint16_t y) {
+    bitui_line(ctx, x, y, x + 99, y + 59);
+}
+
+static void run_shallow_line(bitui_t ctx, uint16_t x, uint16_t y) {
+    bitui_line(ctx, x, y, x + 99, y + 9);
+}
+
+static void run_sparkline(bitui_t ctx, uint16_t x, uint16_t y) {
+    bitui_point_t points[SPARKLINE_POINTS];
+    for (int p = 0; p < SPARKLINE_POINTS; ++p)
+        points[p] = (bitui_point_t){ .x = x + sparkline[p].x, .y = y + sparkline[p].y };
+    bitui_polyline(ctx, points, SPARKLINE_POINTS);
+}
+
+static void run_rect(bitui_t ctx, uint16_t x, uint16_t y) {
+    bitui_rect(ctx, (bitui_rect_t){ .x = x, .y = y, .w = 64, .h = 48 });
+}
+
+static void run_rrect(bitui_t ctx, uint16_t x, uint16_t y) {
+    bitui_rrect(ctx, (bitui_rect_t){ .x = x, .y = y, .w = 64, .h = 48 }, 6);
+}
+
+static void run_fill_rect(bitui_t ctx, uint16_t x, uint16_t y) {
+    bitui_fill_rect(ctx, (bitui_rect_t){ .x = x, .y = y, .w = 64, .h = 48 });
+}
+
+static void run_fill_rect_xor(bitui_t ctx, uint16_t x, uint16_t y) {
+    // XOR-ing black leaves the framebuffer as is
+    ctx->rop = BITUI_ROP_XOR;
+    ctx->color = true;
+    bitui_fill_rect(ctx, (bitui_rect_t){ .x = x, .y = y, .w = 64, .h = 48 });
+    ctx->color = false;
+    ctx->rop = BITUI_ROP_COPY;
+}
+
+static void run_paste_bitstream(bitui_t ctx, uint16_t x, uint16_t y) {
+    bitui_paste_bitstream(ctx, sprite, 32, 32, x, y);
+}
+
+static void run_paste_bitmap(bitui_t ctx, uint16_t x, uint16_t y) {
+    bitui_paste_bitmap(ctx, sprite, 32, 32, x, y);
+}
+
+static void run_paste_runs(bitui_t ctx, uint16_t x, uint16_t y) {
+    bitui_paste_runs(ctx, BITUI_RUNS_COLS, sprite, 32, 32, x, y);
+}
+
+// Same glyph loop as the gui, from the source font (bitstream) or from the
+// glyphs converted by glyphconv.py (packed runs).
+static void render_text(bitui_t ctx, bool packed, uint16_t x, uint16_t y) {
+    const GFXfont *font = packed ? &DigitalDisco16pt7bRuns : &DigitalDisco16pt7b;
+    for (const char *c = text; *c; ++c) {
+        const GFXglyph *glyph = &font->glyph[*c - font->first];
+        const uint16_t gx = x + glyph->xOffset, gy = y + glyph->yOffset;
+        if (!packed)
+            bitui_paste_bitstream(ctx, font->bitmap + glyph->bitmapOffset, glyph->width, glyph->height, gx, gy);
+        else if (glyph->bitmapOffset & BITUI_GLYPH_PLAIN)
+            bitui_paste_runs(ctx, BITUI_GLYPH_RUNS, font->bitmap + (glyph->bitmapOffset & ~BITUI_GLYPH_PLAIN), glyph->width, glyph->height, gx, gy);
+        else
+            bitui_paste_packed_runs(ctx, BITUI_GLYPH_RUNS, font->bitmap + glyph->bitmapOffset, glyph->width, glyph->height, gx, gy);
+        x += glyph->xAdvance;
+    }
+}
+
+static void run_text_bitstream(bitui_t ctx, uint16_t x, uint16_t y) {
+    render_text(ctx, false, x, y + DigitalDisco16pt7b.yAdvance);
+}
+
+static void run_text_packed(bitui_t ctx, uint16_t x, uint16_t y) {
+    render_text(ctx, true, x, y + DigitalDisco16pt7b.yAdvance);
+}
+
+static bench_t benches[] = {
+    { "clear",           0,   0, run_clear },
+    { "hline",         100,   1, run_hline },
+    { "vline",           1, 100, run_vline },
+    { "line",          100,  60, run_line },
+    { "shallow_line",  100,  10, run_shallow_line },
+    { "sparkline",     129,  40, run_sparkline },
+    { "rect",           64,  48, run_rect },
+    { "rrect",          64,  48, run_rrect },
+    { "fill_rect",      64,  48, run_fill_rect },
+    { "fill_rect_xor",  64,  48, run_fill_rect_xor },
+    { "paste_bitstream", 32, 32, run_paste_bitstream },
+    { "paste_bitmap",   32,  32, run_paste_bitmap },
+    { "paste_runs",     32,  32, run_paste_runs },
+    { "text_bitstream",  0,   0, run_text_bitstream },
+    { "text_packed",     0,   0, run_text_packed },
+};
+
+// Pixels drawn by a call: outlines count their perimeter, the rest their area
+static uint32_t bench_pixels(const bench_t *bench, bitui_point_t screen) {
+    if (bench->run == run_clear)
+        return (uint32_t)screen.x * screen.y;
+    if (bench->run == run_hline || bench->run == run_vline || bench->run == run_line || bench->run == run_shallow_line)
+        return 100;
+    if (bench->run == run_sparkline)
+        return bench->w;
+    if (bench->run == run_rect || bench->run == run_rrect)
+        return 2 * (bench->w + bench->h) - 4;
+    if (bench->run == run_text_bitstream || bench->run == run_text_packed) {
+        uint32_t pixels = 0;
+        for (const char *c = text; *c; ++c) {
+            const GFXglyph *glyph = &DigitalDisco16pt7b.glyph[*c - DigitalDisco16pt7b.first];
+            pixels += glyph->width * glyph->height;
+        }
+        return pixels;
+    }
+    return (uint32_t)bench->w * bench->h;
+}
+
+static uint16_t text_width(void) {
+    uint16_t w = 0;
+    for (const char *c = text; *c; ++c)
+        w += DigitalDisco16pt7b.glyph[*c - DigitalDisco16pt7b.first].xAdvance;
+    return w;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static bool selected(const char *name, int argc, char *argv[]) {
+    if (argc == 0)
+        return true;
+    for (int i = 0; i < argc; ++i)
+        if (strcmp(argv[i], name) == 0)
+            return true;
+    return false;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned duration_ms = 100;
+    double rv32_mhz = 0, rv32_slowdown = 0;
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        if (strcmp(argv[i], "--ms") == 0 && i + 1 < argc) {
+            duration_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rv32") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%lf:%lf", &rv32_mhz, &rv32_slowdown) != 2) {
+                fprintf(stderr, "--rv32 expects MHZ:SLOWDOWN\n");
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Usage: %s [--ms MILLISECONDS] [--rv32 MHZ:SLOWDOWN] [primitive...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    srand(1);
+    for (size_t b = 0; b < sizeof(sprite); ++b)
+        sprite[b] = rand();
+    for (int p = 0, y = 20; p < SPARKLINE_POINTS; ++p) {
+        y += rand() % 3 - 1;
+        y = y < 0 ? 0 : y > 39 ? 39 : y;
+        sparkline[p] = (bitui_point_t){ .x = p * 4, .y = y };
+    }
+
+#ifdef BITUI_SWAP_XY
+    const char *layout = "swap_xy";
+    bitui_ctx_t ctx = { .width = PANEL_ROWS, .height = PANEL_COLS, .stride = PANEL_STRIDE, .framebuffer = framebuffer };
+#else
+    const char *layout = "rows";
+    bitui_ctx_t ctx = { .width = PANEL_COLS, .height = PANEL_ROWS, .stride = PANEL_STRIDE, .framebuffer = framebuffer };
+#endif
+
+    printf("%-8s %-4s %-16s %12s %10s", "layout", "rot", "primitive", "ns/call", "Mpx/s");
+    if (rv32_mhz > 0)
+        printf(" %14s", "rv32 cycles");
+    putchar('\n');
+
+#ifdef BITUI_ROTATION
+    for (int rot = BITUI_ROT_000; rot <= BITUI_ROT_270; ++rot) {
+        ctx.rot = rot;
+        const bitui_point_t screen = rot & 1
+            ? (bitui_point_t){ .x = ctx.height, .y = ctx.width }
+            : (bitui_point_t){ .x = ctx.width, .y = ctx.height };
+#else
+    {
+        const int rot = BITUI_ROT_000;
+        const bitui_point_t screen = { .x = ctx.width, .y = ctx.height };
+#endif
+        for (size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); ++b) {
+            const bench_t *bench = &benches[b];
+            if (!selected(bench->name, argc - i, argv + i))
+                continue;
+
+            // Calls stay on screen, text included
+            uint16_t w = bench->w, h = bench->h;
+            if (bench->run == run_text_bitstream || bench->run == run_text_packed) {
+                w = text_width();
+                h = DigitalDisco16pt7b.yAdvance * 2;
+            }
+            const uint16_t range_x = screen.x > w ? screen.x - w : 1;
+            const uint16_t range_y = screen.y > h ? screen.y - h : 1;
+
+            bitui_clear(&ctx, true);
+            ctx.color = false;
+
+            uint64_t calls = 0;
+            uint32_t seed = 1;
+            const uint64_t start = now_ns();
+            uint64_t elapsed = 0;
+            do {
+                for (int n = 0; n < 64; ++n, ++calls) {
+                    seed = seed * 1664525u + 1013904223u;
+                    bench->run(&ctx, (seed >> 8) % range_x, (seed >> 20) % range_y);
+                }
+                elapsed = now_ns() - start;
+            } while (elapsed < duration_ms * 1000000ull);
+
+            const double ns_per_call = (double)elapsed / calls;
+            const double mpx_per_s = bench_pixels(bench, screen) / ns_per_call * 1e3;
+            printf("%-8s %03d  %-16s %12.1f %10.1f", layout, rot * 90, bench->name, ns_per_call, mpx_per_s);
+            if (rv32_mhz > 0)
+                printf(" %14.0f", ns_per_call * rv32_slowdown * rv32_mhz / 1e3);
+            putchar('\n');
+        }
+    }
+    return 0;
+}
@@ -8,15 +8,7 @@
     (B) = __tmp; \
 } while (0)
 
-void bitui_clear(bitui_t ctx, bool color) {
-    size_t count;
-#ifndef BITUI_SWAP_XY
-    count = ctx->stride * ctx->height;
-#else
-    count = ctx->stride * ctx->width;
-#endif
-    memset(ctx->framebuffer, color ? 0xff : 0, count);
-}
+#define BITUI_ALWAYS_INLINE inline __attribute__((always_inline))
 
 static inline void bitui_merge_rect(bitui_rect_t *dst, const bitui_rect_t src) {
     if (src.w == 0 || src.h == 0)
@@ -42,214 +34,1374 @@ static inline void bitui_merge_rect(bitui_rect_t *dst, const bitui_rect_t src) {
     dst->h = (dst_bottom > src_bottom ? dst_bottom : src_bottom) - dst->y + 1;
 }
 
-static inline void bitui_colorize(bitui_t ctx, uint16_t offset, uint8_t updated_pixels_mask) {
-    uint8_t temp = ctx->framebuffer[offset] & ~updated_pixels_mask;
-    if (ctx->color) temp |= updated_pixels_mask;
-    ctx->framebuffer[offset] = temp;
+/* Damage tracking */
+
+static inline bool bitui_tile_damaged(bitui_t ctx, uint16_t tx, uint16_t ty) {
+    const uint16_t tile = ty * BITUI_TILES(ctx->width) + tx;
+    return ctx->damage[tile / 8] & (0x80 >> (tile & 7));
 }
 
-#ifdef BITUI_ROTATION
-#define bitui_rotate(Ctx, X, Y) do { \
-    bitui_point_t p = { .x = *(X), .y = *(Y) }; \
-    p = bitui_apply_rot((Ctx), p); \
-    *(X) = p.x; \
-    *(Y) = p.y; \
-} while (0)
+// Damages the framebuffer pixels [x1, x2] x [y1, y2], already clipped.
+static void bitui_damage_native(bitui_t ctx, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2) {
+    if (x1 > x2) SWAP_U16(x1, x2);
+    if (y1 > y2) SWAP_U16(y1, y2);
 
-bitui_point_t bitui_apply_rot(bitui_t ctx, bitui_point_t point) {
-    _Static_assert(BITUI_ROT_270 == (BITUI_ROT_090 | BITUI_ROT_180), "Rotation bitwise composition");
-    if (ctx->rot & BITUI_ROT_090) {
-        uint16_t t = point.x;
-        point.x = ctx->width - 1 - point.y;
-        point.y = t;
+    if (ctx->damage == NULL) {
+        bitui_merge_rect(&ctx->dirty, (bitui_rect_t){ .x = x1, .y = y1, .w = x2 - x1 + 1, .h = y2 - y1 + 1 });
+        return;
     }
-    if (ctx->rot & BITUI_ROT_180) {
-        point.x = ctx->width - 1 - point.x;
-        point.y = ctx->height - 1 - point.y;
+
+    const uint16_t tiles_w = BITUI_TILES(ctx->width);
+    for (uint16_t ty = y1 / BITUI_TILE; ty <= y2 / BITUI_TILE; ++ty) {
+        for (uint16_t tx = x1 / BITUI_TILE; tx <= x2 / BITUI_TILE; ++tx) {
+            const uint16_t tile = ty * tiles_w + tx;
+            ctx->damage[tile / 8] |= 0x80 >> (tile & 7);
+        }
     }
-    return point;
 }
+
+bool bitui_next_damage(bitui_t ctx, bitui_rect_t *window) {
+    const uint16_t tiles_w = BITUI_TILES(ctx->width);
+    const uint16_t tiles_h = BITUI_TILES(ctx->height);
+    uint16_t tx1, ty1, tx2, ty2;
+
+    if (ctx->damage == NULL) {
+        if (ctx->dirty.w == 0 || ctx->dirty.h == 0)
+            return false;
+        tx1 = ctx->dirty.x / BITUI_TILE;
+        ty1 = ctx->dirty.y / BITUI_TILE;
+        tx2 = (ctx->dirty.x + ctx->dirty.w - 1) / BITUI_TILE;
+        ty2 = (ctx->dirty.y + ctx->dirty.h - 1) / BITUI_TILE;
+        ctx->dirty = (bitui_rect_t){ 0 };
+    } else {
+        // First damaged tile in raster order
+        const uint16_t size = BITUI_DAMAGE_SIZE(ctx->width, ctx->height);
+        uint16_t byte = 0;
+        while (byte < size && ctx->damage[byte] == 0) ++byte;
+        if (byte == size)
+            return false;
+        uint16_t tile = byte * 8;
+        while (!(ctx->damage[byte] & (0x80 >> (tile & 7)))) ++tile;
+        tx1 = tx2 = tile % tiles_w;
+        ty1 = ty2 = tile / tiles_w;
+
+        // Grow the window right along the row, then down while the rows below
+        // are damaged on the same span
+        while (tx2 + 1 < tiles_w && bitui_tile_damaged(ctx, tx2 + 1, ty1)) ++tx2;
+        for (bool full = true; full && ty2 + 1 < tiles_h; ) {
+            for (uint16_t tx = tx1; full && tx <= tx2; ++tx)
+                full = bitui_tile_damaged(ctx, tx, ty2 + 1);
+            if (full) ++ty2;
+        }
+
+        for (uint16_t ty = ty1; ty <= ty2; ++ty) {
+            for (uint16_t tx = tx1; tx <= tx2; ++tx) {
+                const uint16_t t = ty * tiles_w + tx;
+                ctx->damage[t / 8] &= ~(0x80 >> (t & 7));
+            }
+        }
+    }
+
+    const uint16_t right = (tx2 + 1) * BITUI_TILE < ctx->width ? (tx2 + 1) * BITUI_TILE : ctx->width;
+    const uint16_t bottom = (ty2 + 1) * BITUI_TILE < ctx->height ? (ty2 + 1) * BITUI_TILE : ctx->height;
+    *window = (bitui_rect_t){
+        .x = tx1 * BITUI_TILE, .y = ty1 * BITUI_TILE,
+        .w = right - tx1 * BITUI_TILE, .h = bottom - ty1 * BITUI_TILE,
+    };
+    return true;
+}
+
+// Framebuffer rows held by `framebuffer`
+static inline uint16_t bitui_band_rows(bitui_t ctx) {
+    return ctx->band_h ? ctx->band_h : ctx->height;
+}
+
+static inline size_t bitui_framebuffer_size(bitui_t ctx) {
+#ifndef BITUI_SWAP_XY
+    return ctx->stride * bitui_band_rows(ctx);
+#else
+    // The last byte of a column may be partly used, bands always fill theirs
+    if (ctx->band_h == 0)
+        return (size_t)ctx->stride * ctx->width;
+    assert(ctx->band_h % 8 == 0);
+    return ctx->band_h / 8 * ctx->width;
+#endif
+}
+
+// Damages the tile of the framebuffer byte at `offset`.
+static inline void bitui_damage_byte(bitui_t ctx, size_t offset) {
+#ifndef BITUI_SWAP_XY
+    const uint16_t x = offset % ctx->stride * 8;
+    const uint16_t y = offset / ctx->stride + ctx->band_y;
+#else
+    const uint16_t x = offset % ctx->width;
+    const uint16_t y = offset / ctx->width * 8 + ctx->band_y;
+#endif
+    bitui_damage_native(ctx, x, y, x, y);
+}
+
+static void bitui_diff_plane(bitui_t ctx, const uint8_t *plane, uint8_t *previous) {
+    typedef uint32_t __attribute__((may_alias)) word_t;
+    assert(((uintptr_t)plane & 3) == 0 && ((uintptr_t)previous & 3) == 0);
+
+    const size_t size = bitui_framebuffer_size(ctx);
+    const word_t *current = (const word_t*)plane;
+    word_t *flushed = (word_t*)previous;
+
+    size_t offset = 0;
+    for (; offset + sizeof(word_t) <= size; offset += sizeof(word_t)) {
+        const word_t changed = current[offset / sizeof(word_t)] ^ flushed[offset / sizeof(word_t)];
+        if (changed == 0)
+            continue;
+
+        // Bytes of the word in memory order, whatever the endianness
+        uint8_t bytes[sizeof(word_t)];
+        memcpy(bytes, &changed, sizeof(bytes));
+        for (uint8_t i = 0; i < sizeof(bytes); ++i)
+            if (bytes[i]) bitui_damage_byte(ctx, offset + i);
+        flushed[offset / sizeof(word_t)] = current[offset / sizeof(word_t)];
+    }
+    for (; offset < size; ++offset) {
+        if (plane[offset] == previous[offset])
+            continue;
+        bitui_damage_byte(ctx, offset);
+        previous[offset] = plane[offset];
+    }
+}
+
+void bitui_diff_damage(bitui_t ctx, uint8_t *previous) {
+    if (ctx->damage != NULL)
+        memset(ctx->damage, 0, BITUI_DAMAGE_SIZE(ctx->width, ctx->height));
+    else
+        ctx->dirty = (bitui_rect_t){ 0 };
+
+    bitui_diff_plane(ctx, ctx->framebuffer, previous);
+#ifdef BITUI_GRAYSCALE
+    bitui_diff_plane(ctx, ctx->framebuffer_hi, previous + bitui_framebuffer_size(ctx));
+#endif
+}
+
+/* Display lists
+ *
+ * An op is its bitui_op_t, the state it is drawn with, its uint16_t
+ * arguments, then its source pointer and its copied data when it has them.
+ * Ops are padded to stay aligned on 2 bytes.
+ */
+
+typedef enum {
+    BITUI_OP_CLEAR,
+    BITUI_OP_PUSH_CLIP,
+    BITUI_OP_POP_CLIP,
+    BITUI_OP_POINT,
+    BITUI_OP_HLINE,
+    BITUI_OP_VLINE,
+    BITUI_OP_LINE,
+    BITUI_OP_POLYLINE,  // Data: the points
+    BITUI_OP_RECT,
+    BITUI_OP_RRECT,
+    BITUI_OP_FILL_RECT,
+    BITUI_OP_FILL_RRECT,
+    BITUI_OP_PASTE_BITMAP,
+    BITUI_OP_PASTE_BITSTREAM,
+    BITUI_OP_PASTE_RUNS,
+    BITUI_OP_PASTE_PACKED_RUNS,
+    BITUI_OP_COPY_RECT,
+} bitui_op_t;
+
+static const struct {
+    uint8_t args; // Number of uint16_t arguments
+    bool src;     // Followed by a source pointer
+} bitui_op_layout[] = {
+    [BITUI_OP_CLEAR]             = { 1, false },
+    [BITUI_OP_PUSH_CLIP]         = { 4, false },
+    [BITUI_OP_POP_CLIP]          = { 0, false },
+    [BITUI_OP_POINT]             = { 2, false },
+    [BITUI_OP_HLINE]             = { 3, false },
+    [BITUI_OP_VLINE]             = { 3, false },
+    [BITUI_OP_LINE]              = { 4, false },
+    [BITUI_OP_POLYLINE]          = { 1, false },
+    [BITUI_OP_RECT]              = { 4, false },
+    [BITUI_OP_RRECT]             = { 5, false },
+    [BITUI_OP_FILL_RECT]         = { 4, false },
+    [BITUI_OP_FILL_RRECT]        = { 5, false },
+    [BITUI_OP_PASTE_BITMAP]      = { 4, true },
+    [BITUI_OP_PASTE_BITSTREAM]   = { 4, true },
+    [BITUI_OP_PASTE_RUNS]        = { 5, true },
+    [BITUI_OP_PASTE_PACKED_RUNS] = { 5, true },
+    [BITUI_OP_COPY_RECT]         = { 4, true },
+};
+#define BITUI_OP_MAX_ARGS 5
+
+static inline size_t bitui_op_len(bitui_op_t op, uint16_t data_len) {
+    return 2 + bitui_op_layout[op].args * sizeof(uint16_t)
+        + (bitui_op_layout[op].src ? sizeof(const uint8_t*) : 0)
+        + ((data_len + 1) & ~1u);
+}
+
+// Appends `op`, drawn with the current state. Marks the list as overflowing
+// instead when it doesn't fit.
+static void bitui_record(bitui_t ctx, bitui_op_t op, const uint16_t *args, const uint8_t *src, const void *data, uint16_t data_len) {
+    bitui_list_t *list = ctx->list;
+    const size_t len = bitui_op_len(op, data_len);
+    if (list->overflow || list->len + len > list->capacity) {
+        list->overflow = true;
+        return;
+    }
+
+    uint8_t *at = &list->ops[list->len];
+    *at++ = op;
+    *at++ = ctx->color | ctx->rop << 1
+#ifdef BITUI_GRAYSCALE
+        | ctx->ink << 3
+#endif
+        ;
+    if (bitui_op_layout[op].args) {
+        memcpy(at, args, bitui_op_layout[op].args * sizeof(uint16_t));
+        at += bitui_op_layout[op].args * sizeof(uint16_t);
+    }
+    if (bitui_op_layout[op].src) {
+        memcpy(at, &src, sizeof(src));
+        at += sizeof(src);
+    }
+    if (data_len)
+        memcpy(at, data, data_len);
+    list->len += len;
+}
+
+#define BITUI_RECORD(Ctx, Op, ...) \
+    bitui_record((Ctx), (Op), (const uint16_t[]){ __VA_ARGS__ }, NULL, NULL, 0)
+
+void bitui_list_reset(bitui_list_t *list) {
+    list->len = 0;
+    list->overflow = false;
+}
+
+/* Pixel writes
+ *
+ * With BITUI_GRAYSCALE, every write updates both planes in the same pass:
+ * `framebuffer` holds the low bit of each gray level, `framebuffer_hi` the
+ * high bit.
+ */
+
+#ifndef BITUI_GRAYSCALE
+#define BITUI_LEVEL(Ctx) ((Ctx)->color ? BITUI_WHITE : BITUI_BLACK)
 #else
-#define bitui_rotate(Ctx, X, Y)
+#define BITUI_LEVEL(Ctx) ((Ctx)->color ? BITUI_WHITE : (Ctx)->ink)
+#endif
+
+void bitui_clear(bitui_t ctx, bool color) {
+    if (ctx->list) {
+        BITUI_RECORD(ctx, BITUI_OP_CLEAR, color);
+        return;
+    }
+    memset(ctx->framebuffer, color ? 0xff : 0, bitui_framebuffer_size(ctx));
+#ifdef BITUI_GRAYSCALE
+    memset(ctx->framebuffer_hi, color ? 0xff : 0, bitui_framebuffer_size(ctx));
+#endif
+    bitui_damage_native(ctx, 0, ctx->band_y, ctx->width - 1, ctx->band_y + bitui_band_rows(ctx) - 1);
+}
+
+// Combines `set` (all ones or all zeros) into the `mask` pixels of `dst`. The
+// same expression works on bytes and on words of replicated masks.
+static BITUI_ALWAYS_INLINE uint32_t bitui_rop(bitui_rop_t rop, uint32_t dst, uint32_t mask, bool set) {
+    const uint32_t src = set ? mask : 0;
+    switch (rop) {
+    case BITUI_ROP_OR:  return dst | src;
+    case BITUI_ROP_AND: return dst & (src | ~mask);
+    case BITUI_ROP_XOR: return dst ^ src;
+    default:            return (dst & ~mask) | src;
+    }
+}
+
+// Applies the raster op to the `mask` pixels of `count` consecutive bytes,
+// one word at a time once aligned.
+static void bitui_rop_plane(uint8_t *plane, uint16_t count, uint8_t mask, bitui_rop_t rop, bool set) {
+    typedef uint32_t __attribute__((may_alias)) word_t;
+
+    // Ops that leave the pixels as they are, or set them all to the same value
+    if ((rop == BITUI_ROP_OR || rop == BITUI_ROP_XOR) && !set) return;
+    if (rop == BITUI_ROP_AND && set) return;
+    if (mask == 0xff && rop != BITUI_ROP_XOR) {
+        memset(plane, set ? 0xff : 0x00, count);
+        return;
+    }
+
+    for (; count > 0 && ((uintptr_t)plane & 3) != 0; --count, ++plane)
+        *plane = bitui_rop(rop, *plane, mask, set);
+    const word_t mask_word = mask * 0x01010101u;
+    for (; count >= sizeof(word_t); count -= sizeof(word_t), plane += sizeof(word_t))
+        *(word_t*)plane = bitui_rop(rop, *(word_t*)plane, mask_word, set);
+    for (; count > 0; --count, ++plane)
+        *plane = bitui_rop(rop, *plane, mask, set);
+}
+
+static inline void bitui_colorize(bitui_t ctx, uint16_t offset, uint8_t updated_pixels_mask) {
+    const bitui_gray_t level = BITUI_LEVEL(ctx);
+    ctx->framebuffer[offset] = bitui_rop(ctx->rop, ctx->framebuffer[offset], updated_pixels_mask, level & 1);
+#ifdef BITUI_GRAYSCALE
+    ctx->framebuffer_hi[offset] = bitui_rop(ctx->rop, ctx->framebuffer_hi[offset], updated_pixels_mask, level & 2);
+#endif
+}
+
+// Colorizes the `mask` pixels of `count` consecutive bytes.
+static inline void bitui_colorize_bytes(bitui_t ctx, uint16_t offset, uint16_t count, uint8_t mask) {
+    const bitui_gray_t level = BITUI_LEVEL(ctx);
+    bitui_rop_plane(&ctx->framebuffer[offset], count, mask, ctx->rop, level & 1);
+#ifdef BITUI_GRAYSCALE
+    bitui_rop_plane(&ctx->framebuffer_hi[offset], count, mask, ctx->rop, level & 2);
 #endif
+}
+
+/* Native framebuffer layout */
 
 #ifndef BITUI_SWAP_XY
 #define ROW_AT(X, Y) (Y)
-#define STRIDE(Ctx) (ctx->stride)
+#define STRIDE(Ctx) ((Ctx)->stride)
 #define COL_AT(X, Y) ((X)/8)
 #define BIT_AT(X, Y) (0x80 >> ((X) & 7))
+#define BAND_ROW(Ctx) ((Ctx)->band_y)
 #else
 #define ROW_AT(X, Y) ((Y)/8)
-#define STRIDE(Ctx) (ctx->width)
+#define STRIDE(Ctx) ((Ctx)->width)
 #define COL_AT(X, Y) (X)
 #define BIT_AT(X, Y) (0x80 >> ((Y) & 7))
+#define BAND_ROW(Ctx) ((Ctx)->band_y / 8)
 #endif
-#define IDX_AT(Ctx, X, Y) (ROW_AT(X, Y) * STRIDE(Ctx) + COL_AT(X, Y))
+// Rows are counted from the first one of the band
+#define IDX_AT(Ctx, X, Y) ((ROW_AT(X, Y) - BAND_ROW(Ctx)) * STRIDE(Ctx) + COL_AT(X, Y))
 
-void bitui_point(bitui_t ctx, uint16_t x, uint16_t y) {
-    bitui_rotate(ctx, &x, &y);
+// Runs of pixels packed in the same framebuffer byte follow the "axis", while
+// the "cross" coordinate selects the run.
+#ifndef BITUI_SWAP_XY
+#define RUN_AXIS(X, Y) (X)
+#define RUN_CROSS(X, Y) (Y)
+#define RUN_BYTES(Ctx) ((Ctx)->stride)
+#define RUN_IDX(Ctx, Byte, Cross) (((Cross) - BAND_ROW(Ctx)) * STRIDE(Ctx) + (Byte))
+#else
+#define RUN_AXIS(X, Y) (Y)
+#define RUN_CROSS(X, Y) (X)
+#define RUN_BYTES(Ctx) (((Ctx)->height - 1) / 8 + 1)
+#define RUN_IDX(Ctx, Byte, Cross) (((Byte) - BAND_ROW(Ctx)) * STRIDE(Ctx) + (Cross))
+#endif
 
-    if (x >= ctx->width || y >= ctx->height)
-        return;
+// Native helpers don't check bounds: callers clip beforehand.
 
+static inline void bitui_native_point(bitui_t ctx, uint16_t x, uint16_t y) {
     bitui_colorize(ctx, IDX_AT(ctx, x, y), BIT_AT(x, y));
 }
 
-#ifndef BITUI_SWAP_XY
-void bitui_hline(bitui_t ctx, const uint16_t y, uint16_t x1, uint16_t x2) {
-    if (x1 > x2) SWAP_U16(x1, x2);
+// Colorizes the pixels [a1, a2] of the run `cross`.
+static void bitui_native_run(bitui_t ctx, uint16_t cross, uint16_t a1, uint16_t a2) {
+    if (a1 > a2) SWAP_U16(a1, a2);
 
-    bitui_merge_rect(&ctx->dirty, (bitui_rect_t){ .x = x1, .y = y, .w = x2-x1, .h = 1 });
     // [not aligned][aligned][not aligned]
+    uint16_t byte = a1 / 8;
+    const uint16_t last_byte = a2 / 8;
 
-    const uint16_t row_start = y * ctx->stride;
-    uint16_t x1_aligned = x1 / 8;
-    const uint16_t x1_rem = x1 & 7;
-    const uint16_t x2_aligned = x2 / 8;
-    const uint16_t x2_rem = x2 & 7;
-    if (x1_aligned == x2_aligned) {
-        // x1 = 0
-        // x2 = 3
-        // ****....
-        // ^  ^
-        // x1 x2
-        // mask = (0xff >> 0)
-
-        // x1 = 3
-        // x2 = 7
-        // ....****
-        //     ^  ^
-        //     x1 x2
-        // TODO : Xor should also work (and one less op) but I'm not sure at 100%
-        uint8_t mask = (0xff >> x1_rem) & ~(0xff >> x2_rem);
-        bitui_colorize(ctx, row_start + x1_aligned, mask);
-    } else {
-        uint8_t mask = (0xff >> x1_rem);
-        bitui_colorize(ctx, row_start + x1_aligned, mask);
-        x1_aligned += 1;
+    // a1 = 0
+    // a2 = 3
+    // ****....
+    // ^  ^
+    // a1 a2
+    // mask = (0xff >> 0) & (0xff << 4)
 
-        const uint8_t fill = ctx->color ? 0xff : 0x00;
-        for (; x1_aligned < x2_aligned; ++x1_aligned) {
-            ctx->framebuffer[row_start + x1_aligned] = fill;
-        }
+    // a1 = 3
+    // a2 = 7
+    // ...*****
+    //    ^   ^
+    //    a1  a2
+    // mask = (0xff >> 3) & (0xff << 0)
+    const uint8_t first_mask = 0xff >> (a1 & 7);
+    const uint8_t last_mask = 0xff << (7 - (a2 & 7));
+    if (byte == last_byte) {
+        bitui_colorize(ctx, RUN_IDX(ctx, byte, cross), first_mask & last_mask);
+        return;
+    }
+
+    bitui_colorize(ctx, RUN_IDX(ctx, byte, cross), first_mask);
+#ifndef BITUI_SWAP_XY
+    bitui_colorize_bytes(ctx, RUN_IDX(ctx, byte + 1, cross), last_byte - byte - 1, 0xff);
+    byte = last_byte;
+#else
+    for (++byte; byte < last_byte; ++byte) {
+        bitui_colorize(ctx, RUN_IDX(ctx, byte, cross), 0xff);
+    }
+#endif
+    bitui_colorize(ctx, RUN_IDX(ctx, byte, cross), last_mask);
+}
+
+// Colorizes the pixel `axis` of the runs [c1, c2].
+static void bitui_native_across(bitui_t ctx, uint16_t axis, uint16_t c1, uint16_t c2) {
+    if (c1 > c2) SWAP_U16(c1, c2);
+
+    const uint16_t byte = axis / 8;
+    const uint8_t mask = 0x80 >> (axis & 7);
+#ifndef BITUI_SWAP_XY
+    for (; c1 <= c2; ++c1) {
+        bitui_colorize(ctx, RUN_IDX(ctx, byte, c1), mask);
+    }
+#else
+    // The same byte of consecutive runs is contiguous in memory
+    bitui_colorize_bytes(ctx, RUN_IDX(ctx, byte, c1), c2 - c1 + 1, mask);
+#endif
+}
+
+// Colorizes the `mask` pixels of the byte `byte` in the `count` runs from
+// `cross`.
+static inline void bitui_native_span(bitui_t ctx, uint16_t byte, uint16_t cross, uint16_t count, uint8_t mask) {
+    // Distance between the same byte of consecutive runs
+#ifndef BITUI_SWAP_XY
+    const uint16_t step = STRIDE(ctx);
+#else
+    const uint16_t step = 1;
+    if (count >= 8) {
+        bitui_colorize_bytes(ctx, RUN_IDX(ctx, byte, cross), count, mask);
+        return;
+    }
+#endif
+    for (uint16_t offset = RUN_IDX(ctx, byte, cross); count > 0; --count, offset += step) {
+        bitui_colorize(ctx, offset, mask);
+    }
+}
+
+// Colorizes the pixels [a1, a2] of the runs [c1, c2].
+static void bitui_native_fill(bitui_t ctx, uint16_t a1, uint16_t a2, uint16_t c1, uint16_t c2) {
+    if (a1 > a2) SWAP_U16(a1, a2);
+    if (c1 > c2) SWAP_U16(c1, c2);
+
+#ifndef BITUI_SWAP_XY
+    // Each run is contiguous in memory
+    for (; c1 <= c2; ++c1) {
+        bitui_native_run(ctx, c1, a1, a2);
+    }
+#else
+    // The same byte of consecutive runs is contiguous in memory
+    const uint16_t first_byte = a1 / 8;
+    const uint16_t last_byte = a2 / 8;
+    for (uint16_t byte = first_byte; byte <= last_byte; ++byte) {
+        uint8_t mask = 0xff;
+        if (byte == first_byte) mask &= 0xff >> (a1 & 7);
+        if (byte == last_byte) mask &= 0xff << (7 - (a2 & 7));
+
+        bitui_colorize_bytes(ctx, RUN_IDX(ctx, byte, c1), c2 - c1 + 1, mask);
+    }
+#endif
+}
 
-        if (x2_rem) {
-            mask = ~(0xff >> x2_rem);
-            bitui_colorize(ctx, row_start + x1_aligned, mask);
+// Copies the `mask` pixels of `count` consecutive bytes from `src`, one word
+// at a time once `dst` is aligned.
+static inline void bitui_copy_plane(uint8_t *dst, const uint8_t *src, uint16_t count, uint8_t mask) {
+    typedef uint32_t __attribute__((may_alias)) word_t;
+
+    if (mask == 0xff) {
+        memcpy(dst, src, count);
+        return;
+    }
+    for (; count > 0 && ((uintptr_t)dst & 3) != 0; --count, ++dst, ++src)
+        *dst = (*dst & ~mask) | (*src & mask);
+    // Both are aligned when they are framebuffers of the same layout, and
+    // the band (if any) starts on a word
+    if (((uintptr_t)src & 3) == 0) {
+        const uint32_t mask_word = mask * 0x01010101u;
+        for (; count >= sizeof(word_t); count -= sizeof(word_t), dst += sizeof(word_t), src += sizeof(word_t))
+            *(word_t*)dst = (*(word_t*)dst & ~mask_word) | (*(const word_t*)src & mask_word);
+    }
+    for (; count > 0; --count, ++dst, ++src)
+        *dst = (*dst & ~mask) | (*src & mask);
+}
+
+static inline void bitui_copy_bytes(bitui_t ctx, const uint8_t *src, size_t plane, uint16_t offset, uint16_t count, uint8_t mask) {
+    // `src` holds every row, `framebuffer` only the ones of the band
+    const size_t src_offset = offset + BAND_ROW(ctx) * STRIDE(ctx);
+    bitui_copy_plane(&ctx->framebuffer[offset], &src[src_offset], count, mask);
+#ifdef BITUI_GRAYSCALE
+    bitui_copy_plane(&ctx->framebuffer_hi[offset], &src[plane + src_offset], count, mask);
+#else
+    (void)plane;
+#endif
+}
+
+// Copies the pixels [a1, a2] of the runs [c1, c2] from `src`, a whole
+// framebuffer whose planes are `plane` bytes apart.
+static void bitui_native_copy(bitui_t ctx, const uint8_t *src, size_t plane, uint16_t a1, uint16_t a2, uint16_t c1, uint16_t c2) {
+    if (a1 > a2) SWAP_U16(a1, a2);
+    if (c1 > c2) SWAP_U16(c1, c2);
+
+    const uint16_t first_byte = a1 / 8;
+    const uint16_t last_byte = a2 / 8;
+    const uint8_t first_mask = 0xff >> (a1 & 7);
+    const uint8_t last_mask = 0xff << (7 - (a2 & 7));
+#ifndef BITUI_SWAP_XY
+    // Each run is contiguous in memory
+    for (; c1 <= c2; ++c1) {
+        if (first_byte == last_byte) {
+            bitui_copy_bytes(ctx, src, plane, RUN_IDX(ctx, first_byte, c1), 1, first_mask & last_mask);
+            continue;
         }
+        bitui_copy_bytes(ctx, src, plane, RUN_IDX(ctx, first_byte, c1), 1, first_mask);
+        bitui_copy_bytes(ctx, src, plane, RUN_IDX(ctx, first_byte + 1, c1), last_byte - first_byte - 1, 0xff);
+        bitui_copy_bytes(ctx, src, plane, RUN_IDX(ctx, last_byte, c1), 1, last_mask);
     }
+#else
+    // The same byte of consecutive runs is contiguous in memory
+    for (uint16_t byte = first_byte; byte <= last_byte; ++byte) {
+        uint8_t mask = 0xff;
+        if (byte == first_byte) mask &= first_mask;
+        if (byte == last_byte) mask &= last_mask;
+
+        bitui_copy_bytes(ctx, src, plane, RUN_IDX(ctx, byte, c1), c2 - c1 + 1, mask);
+    }
+#endif
 }
 
-void bitui_vline(bitui_t ctx, uint16_t x, uint16_t y1, uint16_t y2)
-{
-    if (y1 > y2) SWAP_U16(y1, y2);
+static inline void bitui_native_line(bitui_t ctx, bitui_point_t p1, bitui_point_t p2) {
+    if (RUN_CROSS(p1.x, p1.y) == RUN_CROSS(p2.x, p2.y))
+        bitui_native_run(ctx, RUN_CROSS(p1.x, p1.y), RUN_AXIS(p1.x, p1.y), RUN_AXIS(p2.x, p2.y));
+    else if (RUN_AXIS(p1.x, p1.y) == RUN_AXIS(p2.x, p2.y))
+        bitui_native_across(ctx, RUN_AXIS(p1.x, p1.y), RUN_CROSS(p1.x, p1.y), RUN_CROSS(p2.x, p2.y));
+    else
+        assert(0 && "Unsupported non axis aligned lines");
+}
+
+/* Rotation
+ *
+ * Every primitive is written once as an always-inlined kernel taking the
+ * rotation as a parameter. BITUI_SPECIALIZE branches on `ctx->rot` once per
+ * primitive and calls the kernel with a constant rotation, so that the
+ * compiler emits one copy of the kernel per rotation where the transform of
+ * the inner loops is reduced to a few additions. Without BITUI_ROTATION, only
+ * the BITUI_ROT_000 copy is emitted.
+ */
+
+static BITUI_ALWAYS_INLINE bitui_point_t bitui_rot_point(bitui_t ctx, const bitui_rot rot, bitui_point_t p) {
+    _Static_assert(BITUI_ROT_270 == (BITUI_ROT_090 | BITUI_ROT_180), "Rotation bitwise composition");
+    switch (rot) {
+    case BITUI_ROT_000: return p;
+    case BITUI_ROT_090: return (bitui_point_t){ .x = ctx->width - 1 - p.y, .y = p.x };
+    case BITUI_ROT_180: return (bitui_point_t){ .x = ctx->width - 1 - p.x, .y = ctx->height - 1 - p.y };
+    case BITUI_ROT_270: return (bitui_point_t){ .x = p.y, .y = ctx->height - 1 - p.x };
+    }
+    return p;
+}
 
-    bitui_merge_rect(&ctx->dirty, (bitui_rect_t){ .x = x, .y = y1, .w = 1, .h = y2-y1 });
+// Size of the framebuffer as seen by the caller
+static BITUI_ALWAYS_INLINE bitui_point_t bitui_rot_size(bitui_t ctx, const bitui_rot rot) {
+    return (rot & BITUI_ROT_090) ? (bitui_point_t){ .x = ctx->height, .y = ctx->width }
+        : (bitui_point_t){ .x = ctx->width, .y = ctx->height };
+}
 
-    const uint8_t col = x / 8;
-    const uint8_t mask = 0x80 >> (x & 7);
-    const uint16_t s = ctx->stride;
+#ifdef BITUI_ROTATION
+#define BITUI_SPECIALIZE(Kernel, Ctx, ...) do { \
+    switch ((Ctx)->rot) { \
+    case BITUI_ROT_000: Kernel((Ctx), BITUI_ROT_000, __VA_ARGS__); break; \
+    case BITUI_ROT_090: Kernel((Ctx), BITUI_ROT_090, __VA_ARGS__); break; \
+    case BITUI_ROT_180: Kernel((Ctx), BITUI_ROT_180, __VA_ARGS__); break; \
+    case BITUI_ROT_270: Kernel((Ctx), BITUI_ROT_270, __VA_ARGS__); break; \
+    } \
+} while (0)
 
-    for (; y1 <= y2; ++y1) {
-        bitui_colorize(ctx, y1 * s + col, mask);
+bitui_point_t bitui_apply_rot(bitui_t ctx, bitui_point_t point) {
+    switch (ctx->rot) {
+    case BITUI_ROT_000: return bitui_rot_point(ctx, BITUI_ROT_000, point);
+    case BITUI_ROT_090: return bitui_rot_point(ctx, BITUI_ROT_090, point);
+    case BITUI_ROT_180: return bitui_rot_point(ctx, BITUI_ROT_180, point);
+    case BITUI_ROT_270: return bitui_rot_point(ctx, BITUI_ROT_270, point);
     }
+    return point;
+}
+#else
+#define BITUI_SPECIALIZE(Kernel, Ctx, ...) Kernel((Ctx), BITUI_ROT_000, __VA_ARGS__)
+#endif
+
+/* Clipping
+ *
+ * Primitives intersect their bounding box with the clip rect on top of the
+ * stack once, before any pixel work, then only iterate on the visible part.
+ */
+
+static inline bitui_rect_t bitui_intersect(const bitui_rect_t a, const bitui_rect_t b) {
+    const uint32_t left   = a.x > b.x ? a.x : b.x;
+    const uint32_t top    = a.y > b.y ? a.y : b.y;
+    const uint32_t right  = (uint32_t)a.x + a.w < (uint32_t)b.x + b.w ? (uint32_t)a.x + a.w : (uint32_t)b.x + b.w;
+    const uint32_t bottom = (uint32_t)a.y + a.h < (uint32_t)b.y + b.h ? (uint32_t)a.y + a.h : (uint32_t)b.y + b.h;
+    if (left >= right || top >= bottom)
+        return (bitui_rect_t){ 0 };
+    return (bitui_rect_t){ .x = left, .y = top, .w = right - left, .h = bottom - top };
 }
+
+static inline bitui_rect_t bitui_clip(bitui_t ctx) {
+    if (ctx->clip_depth > 0)
+        return ctx->clips[ctx->clip_depth - 1];
+
+#ifdef BITUI_ROTATION
+    const bitui_rot rot = ctx->rot;
 #else
-void bitui_vline(bitui_t ctx, const uint16_t x, uint16_t y1, uint16_t y2) {
+    const bitui_rot rot = BITUI_ROT_000;
+#endif
+    const bitui_point_t size = bitui_rot_size(ctx, rot);
+    if (ctx->band_h == 0)
+        return (bitui_rect_t){ .x = 0, .y = 0, .w = size.x, .h = size.y };
+
+    // Framebuffer rows of the band, in the caller's coordinates
+    const uint16_t y = ctx->band_y, h = ctx->band_h;
+    switch (rot) {
+    case BITUI_ROT_090: return (bitui_rect_t){ .x = y, .y = 0, .w = h, .h = size.y };
+    case BITUI_ROT_180: return (bitui_rect_t){ .x = 0, .y = ctx->height - y - h, .w = size.x, .h = h };
+    case BITUI_ROT_270: return (bitui_rect_t){ .x = ctx->height - y - h, .y = 0, .w = h, .h = size.y };
+    default:            return (bitui_rect_t){ .x = 0, .y = y, .w = size.x, .h = h };
+    }
+}
+
+void bitui_set_band(bitui_t ctx, uint16_t y, uint16_t h) {
+    assert(ctx->clip_depth == 0 && "bitui_set_band within a clip");
+    assert(h == 0 || (uint32_t)y + h <= ctx->height);
+#ifdef BITUI_SWAP_XY
+    assert(y % 8 == 0 && h % 8 == 0 && "Bands must hold whole framebuffer bytes");
+#endif
+    ctx->band_y = h ? y : 0;
+    ctx->band_h = h;
+}
+
+bool bitui_push_clip(bitui_t ctx, bitui_rect_t rect) {
+    if (ctx->clip_depth == (ctx->list ? BITUI_CLIP_DEPTH - 1 : BITUI_CLIP_DEPTH))
+        return false;
+    ctx->clips[ctx->clip_depth] = bitui_intersect(bitui_clip(ctx), rect);
+    ctx->clip_depth++;
+    if (ctx->list)
+        BITUI_RECORD(ctx, BITUI_OP_PUSH_CLIP, rect.x, rect.y, rect.w, rect.h);
+    return true;
+}
+
+void bitui_pop_clip(bitui_t ctx) {
+    assert(ctx->clip_depth > 0 && "Unbalanced bitui_pop_clip");
+    ctx->clip_depth--;
+    if (ctx->list)
+        bitui_record(ctx, BITUI_OP_POP_CLIP, NULL, NULL, NULL, 0);
+}
+
+// Damages the pixels of `rect` once rotated. `rect` must be clipped.
+static BITUI_ALWAYS_INLINE void bitui_damage_kernel(bitui_t ctx, const bitui_rot rot, const bitui_rect_t rect) {
+    const bitui_point_t tl = bitui_rot_point(ctx, rot, (bitui_point_t){ .x = rect.x, .y = rect.y });
+    const bitui_point_t br = bitui_rot_point(ctx, rot, (bitui_point_t){ .x = rect.x + rect.w - 1, .y = rect.y + rect.h - 1 });
+    bitui_damage_native(ctx, tl.x, tl.y, br.x, br.y);
+}
+
+static void bitui_damage(bitui_t ctx, const bitui_rect_t rect) {
+    if (rect.w == 0 || rect.h == 0)
+        return;
+    BITUI_SPECIALIZE(bitui_damage_kernel, ctx, rect);
+}
+
+/* Primitives */
+
+static BITUI_ALWAYS_INLINE void bitui_point_kernel(bitui_t ctx, const bitui_rot rot, uint16_t x, uint16_t y) {
+    const bitui_point_t p = bitui_rot_point(ctx, rot, (bitui_point_t){ .x = x, .y = y });
+    bitui_native_point(ctx, p.x, p.y);
+}
+
+void bitui_point(bitui_t ctx, uint16_t x, uint16_t y) {
+    const bitui_rect_t visible = bitui_intersect(bitui_clip(ctx), (bitui_rect_t){ .x = x, .y = y, .w = 1, .h = 1 });
+    if (visible.w == 0)
+        return;
+    if (ctx->list) {
+        BITUI_RECORD(ctx, BITUI_OP_POINT, x, y);
+        return;
+    }
+    bitui_damage(ctx, visible);
+    BITUI_SPECIALIZE(bitui_point_kernel, ctx, x, y);
+}
+
+// Draws the visible part of `rect`, a line one pixel wide or high
+static BITUI_ALWAYS_INLINE void bitui_line_kernel(bitui_t ctx, const bitui_rot rot, const bitui_rect_t clip, const bitui_rect_t rect) {
+    const bitui_rect_t visible = bitui_intersect(clip, rect);
+    if (visible.w == 0)
+        return;
+
+    const bitui_point_t p1 = bitui_rot_point(ctx, rot, (bitui_point_t){ .x = visible.x, .y = visible.y });
+    const bitui_point_t p2 = bitui_rot_point(ctx, rot, (bitui_point_t){ .x = visible.x + visible.w - 1, .y = visible.y + visible.h - 1 });
+    bitui_native_line(ctx, p1, p2);
+}
+
+static inline bitui_rect_t bitui_hline_rect(uint16_t y, uint16_t x1, uint16_t x2) {
+    if (x1 > x2) SWAP_U16(x1, x2);
+    return (bitui_rect_t){ .x = x1, .y = y, .w = x2 - x1 + 1, .h = 1 };
+}
+
+static inline bitui_rect_t bitui_vline_rect(uint16_t x, uint16_t y1, uint16_t y2) {
     if (y1 > y2) SWAP_U16(y1, y2);
+    return (bitui_rect_t){ .x = x, .y = y1, .w = 1, .h = y2 - y1 + 1 };
+}
 
-    // TODO : bitui_merge_rect(&ctx->dirty, (bitui_rect_t){ .x = x1, .y = y, .w = x2-x1, .h = 1 });
-    // [not aligned][aligned][not aligned]
+void bitui_hline(bitui_t ctx, uint16_t y, uint16_t x1, uint16_t x2) {
+    const bitui_rect_t clip = bitui_clip(ctx);
+    const bitui_rect_t line = bitui_hline_rect(y, x1, x2);
+    const bitui_rect_t visible = bitui_intersect(clip, line);
+    if (ctx->list) {
+        if (visible.w != 0) BITUI_RECORD(ctx, BITUI_OP_HLINE, y, x1, x2);
+        return;
+    }
+    bitui_damage(ctx, visible);
+    BITUI_SPECIALIZE(bitui_line_kernel, ctx, clip, line);
+}
 
-    uint16_t y1_aligned = y1 / 8;
-    const uint16_t y1_rem = y1 & 7;
-    const uint16_t y2_aligned = y2 / 8;
-    const uint16_t y2_rem = y2 & 7;
-    if (y1_aligned == y2_aligned) {
-        uint8_t mask = (0xff >> y1_rem) & ~(0xff >> y2_rem);
-        bitui_colorize(ctx, y1_aligned * ctx->width + x, mask);
-    } else {
-        uint8_t mask = (0xff >> y1_rem);
-        bitui_colorize(ctx, y1_aligned * ctx->width + x, mask);
-        y1_aligned += 1;
+void bitui_vline(bitui_t ctx, uint16_t x, uint16_t y1, uint16_t y2) {
+    const bitui_rect_t clip = bitui_clip(ctx);
+    const bitui_rect_t line = bitui_vline_rect(x, y1, y2);
+    const bitui_rect_t visible = bitui_intersect(clip, line);
+    if (ctx->list) {
+        if (visible.w != 0) BITUI_RECORD(ctx, BITUI_OP_VLINE, x, y1, y2);
+        return;
+    }
+    bitui_damage(ctx, visible);
+    BITUI_SPECIALIZE(bitui_line_kernel, ctx, clip, line);
+}
+
+// Integer Bresenham from (a1, c1) to (a2, c2) in native coordinates, which
+// may be offscreen. Lines closer to the byte axis merge the pixels sharing a
+// framebuffer byte into a single write. Lines closer to the other axis keep
+// the same pixel of the byte across consecutive runs for a few steps, and
+// write each of these spans at once. When `clipped`, pixels out of
+// [a_lo, a_hi] x [c_lo, c_hi] are skipped.
+static BITUI_ALWAYS_INLINE void bitui_native_bresenham(bitui_t ctx, int a1, int c1, const int a2, const int c2, bool skip_first,
+        const bool clipped, const int a_lo, const int a_hi, const int c_lo, const int c_hi)
+{
+    const int da = a2 > a1 ? a2 - a1 : a1 - a2;
+    const int dc = c2 > c1 ? c2 - c1 : c1 - c2;
+    const int sa = a1 < a2 ? 1 : -1;
+    const int sc = c1 < c2 ? 1 : -1;
+    int err = da - dc;
 
-        const uint8_t fill = ctx->color ? 0xff : 0x00;
-        for (; y1_aligned < y2_aligned; ++y1_aligned) {
-            ctx->framebuffer[y1_aligned * ctx->width + x] = fill;
+    if (dc > da) {
+        // The cross coordinate moves on every step
+        int span_a = 0, span_c = 0, span_len = 0;
+        for (;;) {
+            const bool drawn = !skip_first && (!clipped || (a1 >= a_lo && a1 <= a_hi && c1 >= c_lo && c1 <= c_hi));
+            skip_first = false;
+            if (drawn && span_len != 0 && a1 == span_a) {
+                span_len++;
+            } else {
+                if (span_len != 0)
+                    bitui_native_span(ctx, span_a / 8, sc > 0 ? span_c : span_c - span_len + 1, span_len, 0x80 >> (span_a & 7));
+                span_a = a1;
+                span_c = c1;
+                span_len = drawn;
+            }
+            if (a1 == a2 && c1 == c2)
+                break;
+
+            const int e2 = 2 * err;
+            if (e2 > -dc) { err -= dc; a1 += sa; }
+            if (e2 < da)  { err += da; c1 += sc; }
         }
+        if (span_len != 0)
+            bitui_native_span(ctx, span_a / 8, sc > 0 ? span_c : span_c - span_len + 1, span_len, 0x80 >> (span_a & 7));
+        return;
+    }
 
-        if (y2_rem) {
-            mask = ~(0xff >> y2_rem);
-            bitui_colorize(ctx, y1_aligned * ctx->width + x, mask);
+    int byte = -1, cross = -1;
+    uint8_t mask = 0;
+    for (;;) {
+        if (skip_first) {
+            skip_first = false;
+        } else if (!clipped || (a1 >= a_lo && a1 <= a_hi && c1 >= c_lo && c1 <= c_hi)) {
+            if (a1 / 8 != byte || c1 != cross) {
+                if (mask) bitui_colorize(ctx, RUN_IDX(ctx, byte, cross), mask);
+                byte = a1 / 8;
+                cross = c1;
+                mask = 0;
+            }
+            mask |= 0x80 >> (a1 & 7);
         }
+        if (a1 == a2 && c1 == c2)
+            break;
+
+        const int e2 = 2 * err;
+        if (e2 > -dc) { err -= dc; a1 += sa; }
+        if (e2 < da)  { err += da; c1 += sc; }
     }
+    if (mask) bitui_colorize(ctx, RUN_IDX(ctx, byte, cross), mask);
 }
 
-void bitui_hline(bitui_t ctx, uint16_t y, uint16_t x1, uint16_t x2)
-{
-    if (x1 > x2) SWAP_U16(x1, x2);
+static inline bitui_rect_t bitui_segment_rect(const bitui_point_t p1, const bitui_point_t p2) {
+    return (bitui_rect_t){
+        .x = p1.x < p2.x ? p1.x : p2.x,
+        .y = p1.y < p2.y ? p1.y : p2.y,
+        .w = (p1.x < p2.x ? p2.x - p1.x : p1.x - p2.x) + 1,
+        .h = (p1.y < p2.y ? p2.y - p1.y : p1.y - p2.y) + 1,
+    };
+}
+
+// With `skip_p1`, the first point is left untouched (already drawn as the
+// end of the previous segment of a polyline).
+static BITUI_ALWAYS_INLINE void bitui_segment_kernel(bitui_t ctx, const bitui_rot rot, const bitui_rect_t clip, bitui_point_t p1, const bitui_point_t p2, const bool skip_p1) {
+    if (p1.x == p2.x || p1.y == p2.y) {
+        if (skip_p1) {
+            if (p1.x == p2.x && p1.y == p2.y)
+                return;
+            if (p1.x != p2.x) p1.x += p1.x < p2.x ? 1 : -1;
+            else              p1.y += p1.y < p2.y ? 1 : -1;
+        }
+        bitui_line_kernel(ctx, rot, clip, bitui_segment_rect(p1, p2));
+        return;
+    }
+
+    const bitui_rect_t bbox = bitui_segment_rect(p1, p2);
 
-    // TODO: bitui_merge_rect(&ctx->dirty, (bitui_rect_t){ .x = x, .y = y1, .w = 1, .h = y2-y1 });
+    const bitui_rect_t visible = bitui_intersect(clip, bbox);
+    if (visible.w == 0)
+        return;
+
+    // Offscreen end points wrap around once rotated: read them as signed
+    const bitui_point_t n1 = bitui_rot_point(ctx, rot, p1);
+    const bitui_point_t n2 = bitui_rot_point(ctx, rot, p2);
+    const int a1 = (int16_t)RUN_AXIS(n1.x, n1.y), c1 = (int16_t)RUN_CROSS(n1.x, n1.y);
+    const int a2 = (int16_t)RUN_AXIS(n2.x, n2.y), c2 = (int16_t)RUN_CROSS(n2.x, n2.y);
 
-    for (; x1 <= x2; ++x1) {
-        bitui_colorize(ctx, IDX_AT(ctx, x1, y), BIT_AT(x1, y));
+    if (visible.w == bbox.w && visible.h == bbox.h) {
+        bitui_native_bresenham(ctx, a1, c1, a2, c2, skip_p1, false, 0, 0, 0, 0);
+        return;
     }
+
+    const bitui_point_t v1 = bitui_rot_point(ctx, rot, (bitui_point_t){ .x = visible.x, .y = visible.y });
+    const bitui_point_t v2 = bitui_rot_point(ctx, rot, (bitui_point_t){ .x = visible.x + visible.w - 1, .y = visible.y + visible.h - 1 });
+    const int va1 = RUN_AXIS(v1.x, v1.y), vc1 = RUN_CROSS(v1.x, v1.y);
+    const int va2 = RUN_AXIS(v2.x, v2.y), vc2 = RUN_CROSS(v2.x, v2.y);
+    bitui_native_bresenham(ctx, a1, c1, a2, c2, skip_p1, true,
+            va1 < va2 ? va1 : va2, va1 < va2 ? va2 : va1,
+            vc1 < vc2 ? vc1 : vc2, vc1 < vc2 ? vc2 : vc1);
 }
-#endif
 
 void bitui_line(bitui_t ctx, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2)
 {
-    bitui_rotate(ctx, &x1, &y1);
-    bitui_rotate(ctx, &x2, &y2);
+    const bitui_point_t p1 = { .x = x1, .y = y1 };
+    const bitui_point_t p2 = { .x = x2, .y = y2 };
+    const bitui_rect_t clip = bitui_clip(ctx);
+    const bitui_rect_t visible = bitui_intersect(clip, bitui_segment_rect(p1, p2));
+    if (ctx->list) {
+        if (visible.w != 0) BITUI_RECORD(ctx, BITUI_OP_LINE, x1, y1, x2, y2);
+        return;
+    }
+    bitui_damage(ctx, visible);
+    BITUI_SPECIALIZE(bitui_segment_kernel, ctx, clip, p1, p2, false);
+}
+
+static BITUI_ALWAYS_INLINE void bitui_polyline_kernel(bitui_t ctx, const bitui_rot rot, const bitui_rect_t clip, const bitui_point_t *points, uint16_t count) {
+    for (uint16_t i = 1; i < count; ++i)
+        bitui_segment_kernel(ctx, rot, clip, points[i - 1], points[i], i > 1);
+}
+
+void bitui_polyline(bitui_t ctx, const bitui_point_t *points, uint16_t count)
+{
+    if (count == 0)
+        return;
+
+    bitui_rect_t bbox = bitui_segment_rect(points[0], points[0]);
+    for (uint16_t i = 1; i < count; ++i)
+        bitui_merge_rect(&bbox, bitui_segment_rect(points[i], points[i]));
+
+    const bitui_rect_t clip = bitui_clip(ctx);
+    const bitui_rect_t visible = bitui_intersect(clip, bbox);
+    if (visible.w == 0)
+        return;
+    if (ctx->list) {
+        bitui_record(ctx, BITUI_OP_POLYLINE, &count, NULL, points, count * sizeof(*points));
+        return;
+    }
+
+    bitui_damage(ctx, visible);
+    if (count == 1)
+        BITUI_SPECIALIZE(bitui_segment_kernel, ctx, clip, points[0], points[0], false);
+    else
+        BITUI_SPECIALIZE(bitui_polyline_kernel, ctx, clip, points, count);
+}
+
+static BITUI_ALWAYS_INLINE void bitui_rect_kernel(bitui_t ctx, const bitui_rot rot, const bitui_rect_t clip, const bitui_rect_t rect) {
+    const uint16_t right  = rect.x + rect.w - 1;
+    const uint16_t bottom = rect.y + rect.h - 1;
 
-    if (x1 == x2) bitui_vline(ctx, x1, y1, y2);
-    else if (y1 == y2) bitui_hline(ctx, y1, x1, x2);
-    else assert(0 && "Unsupported non axis aligned lines");
+    // Every pixel is drawn once, the sides stop short of the corners
+    bitui_line_kernel(ctx, rot, clip, bitui_hline_rect(rect.y, rect.x, right));
+    if (rect.h > 1)
+        bitui_line_kernel(ctx, rot, clip, bitui_hline_rect(bottom, rect.x, right));
+    if (rect.h > 2) {
+        bitui_line_kernel(ctx, rot, clip, bitui_vline_rect(rect.x, rect.y + 1, bottom - 1));
+        if (rect.w > 1)
+            bitui_line_kernel(ctx, rot, clip, bitui_vline_rect(right, rect.y + 1, bottom - 1));
+    }
 }
 
 void bitui_rect(bitui_t ctx, const bitui_rect_t rect) {
+    const bitui_rect_t clip = bitui_clip(ctx);
+    const bitui_rect_t visible = bitui_intersect(clip, rect);
+    if (visible.w == 0)
+        return;
+    if (ctx->list) {
+        BITUI_RECORD(ctx, BITUI_OP_RECT, rect.x, rect.y, rect.w, rect.h);
+        return;
+    }
+    bitui_damage(ctx, visible);
+    BITUI_SPECIALIZE(bitui_rect_kernel, ctx, clip, rect);
+}
+
+// Fills `rect`, which must be clipped.
+static BITUI_ALWAYS_INLINE void bitui_fill_rect_kernel(bitui_t ctx, const bitui_rot rot, const bitui_rect_t rect) {
+    const bitui_point_t tl = bitui_rot_point(ctx, rot, (bitui_point_t){ .x = rect.x, .y = rect.y });
+    const bitui_point_t br = bitui_rot_point(ctx, rot, (bitui_point_t){ .x = rect.x + rect.w - 1, .y = rect.y + rect.h - 1 });
+    bitui_native_fill(ctx, RUN_AXIS(tl.x, tl.y), RUN_AXIS(br.x, br.y), RUN_CROSS(tl.x, tl.y), RUN_CROSS(br.x, br.y));
+}
+
+void bitui_fill_rect(bitui_t ctx, const bitui_rect_t rect) {
+    const bitui_rect_t visible = bitui_intersect(bitui_clip(ctx), rect);
+    if (visible.w == 0)
+        return;
+    if (ctx->list) {
+        BITUI_RECORD(ctx, BITUI_OP_FILL_RECT, rect.x, rect.y, rect.w, rect.h);
+        return;
+    }
+    bitui_damage(ctx, visible);
+    BITUI_SPECIALIZE(bitui_fill_rect_kernel, ctx, visible);
+}
+
+// Copies `rect`, which must be clipped, from `src`.
+static BITUI_ALWAYS_INLINE void bitui_copy_rect_kernel(bitui_t ctx, const bitui_rot rot, const bitui_rect_t rect, const uint8_t *src, size_t plane) {
+    const bitui_point_t tl = bitui_rot_point(ctx, rot, (bitui_point_t){ .x = rect.x, .y = rect.y });
+    const bitui_point_t br = bitui_rot_point(ctx, rot, (bitui_point_t){ .x = rect.x + rect.w - 1, .y = rect.y + rect.h - 1 });
+    bitui_native_copy(ctx, src, plane, RUN_AXIS(tl.x, tl.y), RUN_AXIS(br.x, br.y), RUN_CROSS(tl.x, tl.y), RUN_CROSS(br.x, br.y));
+}
+
+void bitui_copy_rect(bitui_t ctx, const uint8_t *src, const bitui_rect_t rect) {
+    const bitui_rect_t visible = bitui_intersect(bitui_clip(ctx), rect);
+    if (visible.w == 0)
+        return;
+    if (ctx->list) {
+        bitui_record(ctx, BITUI_OP_COPY_RECT, (const uint16_t[]){ rect.x, rect.y, rect.w, rect.h }, src, NULL, 0);
+        return;
+    }
+
+    // Size of a plane of the whole framebuffer
+#ifndef BITUI_SWAP_XY
+    const size_t plane = (size_t)ctx->stride * ctx->height;
+#else
+    const size_t plane = (size_t)RUN_BYTES(ctx) * ctx->width;
+#endif
+    bitui_damage(ctx, visible);
+    BITUI_SPECIALIZE(bitui_copy_rect_kernel, ctx, visible, src, plane);
+}
+
+static uint16_t bitui_isqrt(uint32_t n) {
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > n) bit >>= 2;
+    while (bit) {
+        if (n >= root + bit) {
+            n -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+static inline uint16_t bitui_clamp_radius(const bitui_rect_t rect, uint16_t radius) {
+    if (radius > rect.w / 2) radius = rect.w / 2;
+    if (radius > rect.h / 2) radius = rect.h / 2;
+    return radius;
+}
+
+// Horizontal inset of the row `i` (counted from the top) of a rounded corner.
+// The arc is slightly wider than the radius to avoid pointy corners.
+static inline uint16_t bitui_corner_inset(uint16_t radius, uint16_t i) {
+    const uint32_t dy = radius - i;
+    const uint16_t dx = bitui_isqrt((uint32_t)radius * radius + radius - dy * dy);
+    return dx < radius ? radius - dx : 0;
+}
+
+static BITUI_ALWAYS_INLINE void bitui_rrect_kernel(bitui_t ctx, const bitui_rot rot, const bitui_rect_t clip, const bitui_rect_t rect, const uint16_t radius) {
     const uint16_t left   = rect.x;
     const uint16_t top    = rect.y;
     const uint16_t right  = rect.x + rect.w - 1;
     const uint16_t bottom = rect.y + rect.h - 1;
 
-    bitui_line(ctx,  left,    top, right,    top);
-    bitui_line(ctx,  left,    top,  left, bottom);
-    bitui_line(ctx, right,    top, right, bottom);
-    bitui_line(ctx,  left, bottom, right, bottom);
+    if (radius == 0) {
+        bitui_rect_kernel(ctx, rot, clip, rect);
+        return;
+    }
+
+    uint16_t prev_inset = radius;
+    for (uint16_t i = 0; i < radius; ++i) {
+        const uint16_t inset = bitui_corner_inset(radius, i);
+        // Connect each row of the arc to the previous one
+        const uint16_t end = i == 0 || inset + 1 >= prev_inset ? inset : prev_inset - 1;
+        if (i == 0) {
+            bitui_line_kernel(ctx, rot, clip, bitui_hline_rect(top, left + inset, right - inset));
+            bitui_line_kernel(ctx, rot, clip, bitui_hline_rect(bottom, left + inset, right - inset));
+        } else {
+            bitui_line_kernel(ctx, rot, clip, bitui_hline_rect(top + i, left + inset, left + end));
+            bitui_line_kernel(ctx, rot, clip, bitui_hline_rect(top + i, right - end, right - inset));
+            bitui_line_kernel(ctx, rot, clip, bitui_hline_rect(bottom - i, left + inset, left + end));
+            bitui_line_kernel(ctx, rot, clip, bitui_hline_rect(bottom - i, right - end, right - inset));
+        }
+        prev_inset = inset;
+    }
+
+    if (top + radius <= bottom - radius) {
+        bitui_line_kernel(ctx, rot, clip, bitui_vline_rect(left, top + radius, bottom - radius));
+        bitui_line_kernel(ctx, rot, clip, bitui_vline_rect(right, top + radius, bottom - radius));
+    }
+}
+
+void bitui_rrect(bitui_t ctx, const bitui_rect_t rect, uint16_t radius) {
+    const bitui_rect_t clip = bitui_clip(ctx);
+    const bitui_rect_t visible = bitui_intersect(clip, rect);
+    if (visible.w == 0)
+        return;
+    if (ctx->list) {
+        BITUI_RECORD(ctx, BITUI_OP_RRECT, rect.x, rect.y, rect.w, rect.h, radius);
+        return;
+    }
+    bitui_damage(ctx, visible);
+    BITUI_SPECIALIZE(bitui_rrect_kernel, ctx, clip, rect, bitui_clamp_radius(rect, radius));
+}
+
+static BITUI_ALWAYS_INLINE void bitui_fill_rrect_kernel(bitui_t ctx, const bitui_rot rot, const bitui_rect_t clip, const bitui_rect_t rect, const uint16_t radius) {
+    const uint16_t left   = rect.x;
+    const uint16_t right  = rect.x + rect.w - 1;
+    const uint16_t bottom = rect.y + rect.h - 1;
+
+    for (uint16_t i = 0; i < radius; ++i) {
+        const uint16_t inset = bitui_corner_inset(radius, i);
+        bitui_line_kernel(ctx, rot, clip, bitui_hline_rect(rect.y + i, left + inset, right - inset));
+        bitui_line_kernel(ctx, rot, clip, bitui_hline_rect(bottom - i, left + inset, right - inset));
+    }
+
+    if (rect.h > 2 * radius) {
+        const bitui_rect_t middle = bitui_intersect(clip, (bitui_rect_t){
+            .x = rect.x, .y = rect.y + radius,
+            .w = rect.w, .h = rect.h - 2 * radius,
+        });
+        if (middle.w != 0)
+            bitui_fill_rect_kernel(ctx, rot, middle);
+    }
+}
+
+void bitui_fill_rrect(bitui_t ctx, const bitui_rect_t rect, uint16_t radius) {
+    const bitui_rect_t clip = bitui_clip(ctx);
+    const bitui_rect_t visible = bitui_intersect(clip, rect);
+    if (visible.w == 0)
+        return;
+    if (ctx->list) {
+        BITUI_RECORD(ctx, BITUI_OP_FILL_RRECT, rect.x, rect.y, rect.w, rect.h, radius);
+        return;
+    }
+    bitui_damage(ctx, visible);
+    BITUI_SPECIALIZE(bitui_fill_rrect_kernel, ctx, clip, rect, bitui_clamp_radius(rect, radius));
+}
+
+// Clipped pastes only visit `visible`, the intersection of the destination
+// rect with the clip.
+
+static BITUI_ALWAYS_INLINE void bitui_paste_bitstream_kernel(bitui_t ctx, const bitui_rot rot, const bitui_rect_t visible, const uint8_t *src_bitstream, uint16_t src_w, const uint16_t dst_x, const uint16_t dst_y)
+{
+    for (uint16_t y = visible.y; y < visible.y + visible.h; y++) {
+        uint32_t bit = (uint32_t)(y - dst_y) * src_w + (visible.x - dst_x);
+        for (uint16_t x = visible.x; x < visible.x + visible.w; x++, bit++) {
+            if (src_bitstream[bit / 8] & (0x80 >> (bit & 7)))
+                bitui_point_kernel(ctx, rot, x, y);
+        }
+    }
 }
 
 void bitui_paste_bitstream(bitui_t ctx, const uint8_t *src_bitstream, uint16_t src_w, uint16_t src_h, const uint16_t dst_x, const uint16_t dst_y)
 {
-    uint8_t bits = 0;
-    uint8_t bit = 0;
-    bitui_merge_rect(&ctx->dirty, (bitui_rect_t){ .x = dst_x, .y = dst_y, .w = src_w, .h = src_h });
+    const bitui_rect_t visible = bitui_intersect(bitui_clip(ctx), (bitui_rect_t){ .x = dst_x, .y = dst_y, .w = src_w, .h = src_h });
+    if (visible.w == 0)
+        return;
+    if (ctx->list) {
+        bitui_record(ctx, BITUI_OP_PASTE_BITSTREAM, (const uint16_t[]){ src_w, src_h, dst_x, dst_y }, src_bitstream, NULL, 0);
+        return;
+    }
+    bitui_damage(ctx, visible);
 
-    ctx->color = !ctx->color;
-    for (uint16_t y = dst_y; y < dst_y + src_h; y++) {
-        for (uint16_t x = dst_x; x < dst_x + src_w; x++) {
-            if (!(bit & 7))
-                bits = *(src_bitstream++);
+    BITUI_SPECIALIZE(bitui_paste_bitstream_kernel, ctx, visible, src_bitstream, src_w, dst_x, dst_y);
+}
 
-            if (bits & 0x80)
-                bitui_point(ctx, x, y);
+static BITUI_ALWAYS_INLINE void bitui_paste_bitmap_kernel(bitui_t ctx, const bitui_rot rot, const bitui_rect_t visible, const uint8_t *src_bitmap, uint16_t src_w, uint16_t dst_x, uint16_t dst_y)
+{
+    const uint16_t stride = (src_w - 1) /8 + 1;
 
-            bits <<= 1;
-            ++bit;
+    src_bitmap += (visible.y - dst_y) * stride;
+    for (uint16_t y = visible.y; y < visible.y + visible.h; y++, src_bitmap += stride) {
+        for (uint16_t x = visible.x; x < visible.x + visible.w; x++) {
+            const uint16_t dx = x - dst_x;
+            if (src_bitmap[dx / 8] & (0x80 >> (dx & 7)))
+                bitui_point_kernel(ctx, rot, x, y);
         }
     }
-    ctx->color = !ctx->color;
 }
 
 void bitui_paste_bitmap(bitui_t ctx, const uint8_t *src_bitmap, uint16_t src_w, uint16_t src_h, uint16_t dst_x, uint16_t dst_y)
 {
-    bitui_merge_rect(&ctx->dirty, (bitui_rect_t){ .x = dst_x, .y = dst_y, .w = src_w, .h = src_h });
-    const uint16_t stride = (src_w - 1) /8 + 1;
+    const bitui_rect_t visible = bitui_intersect(bitui_clip(ctx), (bitui_rect_t){ .x = dst_x, .y = dst_y, .w = src_w, .h = src_h });
+    if (visible.w == 0)
+        return;
+    if (ctx->list) {
+        bitui_record(ctx, BITUI_OP_PASTE_BITMAP, (const uint16_t[]){ src_w, src_h, dst_x, dst_y }, src_bitmap, NULL, 0);
+        return;
+    }
+    bitui_damage(ctx, visible);
+    BITUI_SPECIALIZE(bitui_paste_bitmap_kernel, ctx, visible, src_bitmap, src_w, dst_x, dst_y);
+}
+
+static inline uint8_t bitui_reverse_bits(uint8_t b) {
+    b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
+    b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
+    b = (b & 0xAA) >> 1 | (b & 0x55) << 1;
+    return b;
+}
+
+// Colorizes the set bits of `count` source bytes laid along the framebuffer's
+// byte axis, the MSB of the first byte landing on pixel `axis` of the run
+// `cross`. Only the pixels [lo, hi] of the run are written.
+static void bitui_blit_run(bitui_t ctx, int axis, uint16_t cross, const uint8_t *src, uint16_t count, bool reversed, uint16_t lo, uint16_t hi)
+{
+    const int first_byte = lo / 8;
+    const int last_byte = hi / 8;
+    const uint8_t first_mask = 0xff >> (lo & 7);
+    const uint8_t last_mask = 0xff << (7 - (hi & 7));
+
+    const uint8_t shift = axis & 7;
+    int byte = (axis - shift) / 8;
+    uint8_t carry = 0;
+
+    for (uint16_t i = 0; i <= count; ++i, ++byte) {
+        uint8_t mask = carry;
+        if (i < count) {
+            const uint8_t bits = reversed ? bitui_reverse_bits(src[count - 1 - i]) : src[i];
+            mask |= bits >> shift;
+            carry = shift ? bits << (8 - shift) : 0;
+        }
+
+        if (byte < first_byte || byte > last_byte)
+            continue;
+        if (byte == first_byte) mask &= first_mask;
+        if (byte == last_byte) mask &= last_mask;
+        if (mask)
+            bitui_colorize(ctx, RUN_IDX(ctx, byte, cross), mask);
+    }
+}
+
+// Streaming decoder of the lengths written by `glyphconv.py --packed`
+typedef struct {
+    const uint8_t *src;
+    uint16_t nibble; // Index of the next nibble in `src`
+    uint16_t left;   // Pixels left in the current length
+    bool set;        // Whether the current length is made of set pixels
+    uint8_t run[BITUI_PACKED_MAX_RUN / 8];
+} bitui_unpacker_t;
+
+static inline uint16_t bitui_unpack_length(bitui_unpacker_t *u) {
+    uint16_t length = 0;
+    uint8_t n;
+    do {
+        n = (u->src[u->nibble / 2] >> (u->nibble & 1 ? 0 : 4)) & 0xF;
+        u->nibble++;
+        length += n;
+    } while (n == 15);
+    return length;
+}
 
-    for (uint16_t dy = 0; dy < src_h; dy++) {
-        for (uint16_t dx = 0; dx < src_w; dx++) {
-            if (!(src_bitmap[dy * stride + (dx / 8)] & (0x80 >> (dx & 7))))
-                bitui_point(ctx, dst_x + dx, dst_y + dy);
+// Consumes the next `count` pixels, setting bits in `u->run` when `out` is set
+static void bitui_unpack(bitui_unpacker_t *u, uint16_t count, bool out) {
+    uint16_t i = 0;
+    while (i < count) {
+        while (u->left == 0) {
+            u->left = bitui_unpack_length(u);
+            u->set = !u->set;
         }
+
+        const uint16_t n = u->left < count - i ? u->left : count - i;
+        if (out && u->set) {
+            for (uint16_t end = i + n; i < end;) {
+                const uint8_t bits = end - i < 8 - (i & 7) ? end - i : 8 - (i & 7);
+                u->run[i / 8] |= (uint8_t)(0xff00 >> bits) >> (i & 7);
+                i += bits;
+            }
+        } else {
+            i += n;
+        }
+        u->left -= n;
+    }
+}
+
+// Returns the next run of the source, either stored as is or decoded by `u`
+static BITUI_ALWAYS_INLINE const uint8_t *bitui_next_run(bitui_unpacker_t *u, const uint8_t **src_runs, uint16_t run_len, uint16_t run_bytes) {
+    if (u == NULL) {
+        const uint8_t *run = *src_runs;
+        *src_runs += run_bytes;
+        return run;
+    }
+    memset(u->run, 0, run_bytes);
+    bitui_unpack(u, run_len, true);
+    return u->run;
+}
+
+static BITUI_ALWAYS_INLINE void bitui_paste_runs_kernel(bitui_t ctx, const bitui_rot rot, const bitui_rect_t visible, bitui_runs_t layout, bitui_unpacker_t *unpacker, const uint8_t *src_runs, uint16_t src_w, uint16_t src_h, uint16_t dst_x, uint16_t dst_y)
+{
+    const bool cols = layout == BITUI_RUNS_COLS;
+    const uint16_t run_len = cols ? src_h : src_w;
+    const uint16_t run_bytes = (run_len - 1) / 8 + 1;
+
+    // Visible runs, and visible pixels of each run
+    const uint16_t r_first = cols ? visible.x - dst_x : visible.y - dst_y;
+    const uint16_t r_last = r_first + (cols ? visible.w : visible.h) - 1;
+    const uint16_t i_first = cols ? visible.y - dst_y : visible.x - dst_x;
+    const uint16_t i_last = i_first + (cols ? visible.h : visible.w) - 1;
+    if (unpacker) bitui_unpack(unpacker, r_first * run_len, false);
+    else src_runs += r_first * run_bytes;
+
+    // Direction taken by the runs in the framebuffer once rotated
+    const bitui_point_t p0 = bitui_rot_point(ctx, rot, (bitui_point_t){ .x = visible.x, .y = visible.y });
+    const bitui_point_t p1 = bitui_rot_point(ctx, rot, (bitui_point_t){ .x = visible.x + !cols, .y = visible.y + cols });
+    const int16_t dir = (int16_t)(uint16_t)(RUN_AXIS(p1.x, p1.y) - RUN_AXIS(p0.x, p0.y));
+
+    if (dir != 0) {
+        const bitui_point_t p2 = bitui_rot_point(ctx, rot, (bitui_point_t){ .x = visible.x + visible.w - 1, .y = visible.y + visible.h - 1 });
+        const uint16_t lo = dir > 0 ? RUN_AXIS(p0.x, p0.y) : RUN_AXIS(p2.x, p2.y);
+        const uint16_t hi = dir > 0 ? RUN_AXIS(p2.x, p2.y) : RUN_AXIS(p0.x, p0.y);
+
+        for (uint16_t r = r_first; r <= r_last; ++r) {
+            const uint8_t *run = bitui_next_run(unpacker, &src_runs, run_len, run_bytes);
+
+            // First visible pixel of the run, the start of the run may be offscreen
+            const bitui_point_t p = bitui_rot_point(ctx, rot, (bitui_point_t){
+                .x = dst_x + (cols ? r : i_first),
+                .y = dst_y + (cols ? i_first : r),
+            });
+
+            int axis = RUN_AXIS(p.x, p.y) - dir * i_first;
+            if (dir < 0) axis -= run_bytes * 8 - 1;
+            bitui_blit_run(ctx, axis, RUN_CROSS(p.x, p.y), run, run_bytes, dir < 0, lo, hi);
+        }
+    } else {
+        // Runs are perpendicular to the framebuffer bytes
+        for (uint16_t r = r_first; r <= r_last; ++r) {
+            const uint8_t *run = bitui_next_run(unpacker, &src_runs, run_len, run_bytes);
+            for (uint16_t i = i_first; i <= i_last; ++i) {
+                if (!(run[i / 8] & (0x80 >> (i & 7))))
+                    continue;
+                if (cols) bitui_point_kernel(ctx, rot, dst_x + r, dst_y + i);
+                else      bitui_point_kernel(ctx, rot, dst_x + i, dst_y + r);
+            }
+        }
+    }
+}
+
+void bitui_paste_runs(bitui_t ctx, bitui_runs_t layout, const uint8_t *src_runs, uint16_t src_w, uint16_t src_h, uint16_t dst_x, uint16_t dst_y)
+{
+    const bitui_rect_t visible = bitui_intersect(bitui_clip(ctx), (bitui_rect_t){ .x = dst_x, .y = dst_y, .w = src_w, .h = src_h });
+    if (visible.w == 0)
+        return;
+    if (ctx->list) {
+        bitui_record(ctx, BITUI_OP_PASTE_RUNS, (const uint16_t[]){ layout, src_w, src_h, dst_x, dst_y }, src_runs, NULL, 0);
+        return;
     }
+    bitui_damage(ctx, visible);
+
+    BITUI_SPECIALIZE(bitui_paste_runs_kernel, ctx, visible, layout, NULL, src_runs, src_w, src_h, dst_x, dst_y);
+}
+
+void bitui_paste_packed_runs(bitui_t ctx, bitui_runs_t layout, const uint8_t *src_packed, uint16_t src_w, uint16_t src_h, uint16_t dst_x, uint16_t dst_y)
+{
+    if ((layout == BITUI_RUNS_COLS ? src_h : src_w) > BITUI_PACKED_MAX_RUN)
+        return;
+
+    const bitui_rect_t visible = bitui_intersect(bitui_clip(ctx), (bitui_rect_t){ .x = dst_x, .y = dst_y, .w = src_w, .h = src_h });
+    if (visible.w == 0)
+        return;
+    if (ctx->list) {
+        bitui_record(ctx, BITUI_OP_PASTE_PACKED_RUNS, (const uint16_t[]){ layout, src_w, src_h, dst_x, dst_y }, src_packed, NULL, 0);
+        return;
+    }
+    bitui_damage(ctx, visible);
+
+    // The first length is made of unset pixels
+    bitui_unpacker_t unpacker = { .src = src_packed, .set = true };
+    BITUI_SPECIALIZE(bitui_paste_runs_kernel, ctx, visible, layout, &unpacker, NULL, src_w, src_h, dst_x, dst_y);
+}
+
+void bitui_replay(bitui_t ctx, const bitui_list_t *list, bitui_rect_t rect) {
+    assert(ctx->list == NULL && "bitui_replay while recording");
+    const bool color = ctx->color;
+    const bitui_rop_t rop = ctx->rop;
+#ifdef BITUI_GRAYSCALE
+    const bitui_gray_t ink = ctx->ink;
+#endif
+    const uint8_t clip_depth = ctx->clip_depth;
+    if (!bitui_push_clip(ctx, rect))
+        return;
+
+    for (uint16_t at = 0; at < list->len;) {
+        const uint8_t *op = &list->ops[at];
+        const bitui_op_t kind = op[0];
+        ctx->color = op[1] & 1;
+        ctx->rop = (op[1] >> 1) & 3;
+#ifdef BITUI_GRAYSCALE
+        ctx->ink = (op[1] >> 3) & 3;
+#endif
+
+        uint16_t args[BITUI_OP_MAX_ARGS] = { 0 };
+        const uint8_t *src = NULL;
+        const uint8_t *data = op + 2;
+        if (bitui_op_layout[kind].args) {
+            memcpy(args, data, bitui_op_layout[kind].args * sizeof(uint16_t));
+            data += bitui_op_layout[kind].args * sizeof(uint16_t);
+        }
+        if (bitui_op_layout[kind].src) {
+            memcpy(&src, data, sizeof(src));
+            data += sizeof(src);
+        }
+        const bitui_rect_t args_rect = { .x = args[0], .y = args[1], .w = args[2], .h = args[3] };
+
+        uint16_t data_len = 0;
+        switch (kind) {
+        case BITUI_OP_CLEAR: {
+            // Like bitui_clear, ignores the recorded clips but not `rect`
+            const uint8_t depth = ctx->clip_depth;
+            ctx->clip_depth = clip_depth + 1;
+            ctx->color = args[0];
+            ctx->rop = BITUI_ROP_COPY;
+            bitui_fill_rect(ctx, (bitui_rect_t){ .x = 0, .y = 0, .w = UINT16_MAX, .h = UINT16_MAX });
+            ctx->clip_depth = depth;
+        } break;
+        case BITUI_OP_PUSH_CLIP: bitui_push_clip(ctx, args_rect); break;
+        case BITUI_OP_POP_CLIP: bitui_pop_clip(ctx); break;
+        case BITUI_OP_POINT: bitui_point(ctx, args[0], args[1]); break;
+        case BITUI_OP_HLINE: bitui_hline(ctx, args[0], args[1], args[2]); break;
+        case BITUI_OP_VLINE: bitui_vline(ctx, args[0], args[1], args[2]); break;
+        case BITUI_OP_LINE: bitui_line(ctx, args[0], args[1], args[2], args[3]); break;
+        case BITUI_OP_POLYLINE:
+            data_len = args[0] * sizeof(bitui_point_t);
+            bitui_polyline(ctx, (const bitui_point_t*)data, args[0]);
+            break;
+        case BITUI_OP_RECT: bitui_rect(ctx, args_rect); break;
+        case BITUI_OP_RRECT: bitui_rrect(ctx, args_rect, args[4]); break;
+        case BITUI_OP_FILL_RECT: bitui_fill_rect(ctx, args_rect); break;
+        case BITUI_OP_FILL_RRECT: bitui_fill_rrect(ctx, args_rect, args[4]); break;
+        case BITUI_OP_PASTE_BITMAP: bitui_paste_bitmap(ctx, src, args[0], args[1], args[2], args[3]); break;
+        case BITUI_OP_PASTE_BITSTREAM: bitui_paste_bitstream(ctx, src, args[0], args[1], args[2], args[3]); break;
+        case BITUI_OP_PASTE_RUNS: bitui_paste_runs(ctx, args[0], src, args[1], args[2], args[3], args[4]); break;
+        case BITUI_OP_PASTE_PACKED_RUNS: bitui_paste_packed_runs(ctx, args[0], src, args[1], args[2], args[3], args[4]); break;
+        case BITUI_OP_COPY_RECT: bitui_copy_rect(ctx, src, args_rect); break;
+        }
+        at += bitui_op_len(kind, data_len);
+    }
+
+    ctx->clip_depth = clip_depth;
+    ctx->color = color;
+    ctx->rop = rop;
+#ifdef BITUI_GRAYSCALE
+    ctx->ink = ink;
+#endif
 }
@@ -12,7 +12,7 @@ typedef struct {
     uint16_t w, h;
 } bitui_rect_t;
 
-#ifdef BITUI_ROTATION
+// Without BITUI_ROTATION, every primitive uses the BITUI_ROT_000 kernels.
 typedef enum {
     BITUI_ROT_000 = 0x00,
     BITUI_ROT_090 = 0x01,
@@ -20,35 +20,165 @@ typedef enum {
     BITUI_ROT_270 = 0x03,
 } bitui_rot;
 #define BITUI_ROT_INVERT(Rot) ((Rot) ^ BITUI_ROT_270)
-#endif
+
+#define BITUI_CLIP_DEPTH 4
+
+typedef enum {
+    BITUI_BLACK = 0,
+    BITUI_DARK  = 1,
+    BITUI_LIGHT = 2,
+    BITUI_WHITE = 3,
+} bitui_gray_t;
+
+// How drawn pixels are combined with the framebuffer. Every primitive draws
+// each of its pixels once, so XOR-ing the same shape twice restores what was
+// under it (highlights, cursors, inverted labels). Only polyline segments that
+// cross or fold back onto each other share pixels.
+typedef enum {
+    BITUI_ROP_COPY = 0, // Drawn pixels take the current color
+    BITUI_ROP_OR,       // Drawn pixels are OR-ed with the current color
+    BITUI_ROP_AND,      // Drawn pixels are AND-ed with the current color
+    BITUI_ROP_XOR,      // Drawn pixels are XOR-ed with the current color (white inverts)
+} bitui_rop_t;
+
+// Display list of recorded primitives, see `bitui_ctx_t.list`. Blit sources
+// (glyphs, bitmaps) are referenced and must outlive the list, polyline points
+// and bar heights are copied. `ops` is a buffer of `capacity` bytes aligned on
+// 2 bytes.
+typedef struct {
+    uint8_t *ops;
+    uint16_t capacity, len;
+    bool overflow; // Some primitives didn't fit: the list is incomplete
+} bitui_list_t;
 
 typedef struct {
     uint16_t width, height, stride;
+    // Framebuffer rows [band_y, band_y + band_h) only, see bitui_set_band.
+    // The whole framebuffer when band_h is 0.
     uint8_t *framebuffer;
+    uint16_t band_y, band_h;
+#ifdef BITUI_GRAYSCALE
+    // Second plane, with the same layout as `framebuffer`. The gray level of a
+    // pixel is (hi << 1) | lo, 4 levels from BITUI_BLACK to BITUI_WHITE.
+    uint8_t *framebuffer_hi;
+#endif
 
 #ifdef BITUI_ROTATION
     bitui_rot rot;
 #endif
     bool color;
+#ifdef BITUI_GRAYSCALE
+    // Level drawn when `color` is false (`color` true always draws white)
+    bitui_gray_t ink;
+#endif
+    bitui_rop_t rop;
+
+    // Stack of clip rects in the caller's coordinates, each one already
+    // intersected with the previous. Empty means the whole framebuffer.
+    uint8_t clip_depth;
+    bitui_rect_t clips[BITUI_CLIP_DEPTH];
+
+    // Damage is tracked in native framebuffer coordinates (after rotation,
+    // as the bytes are laid out), on tiles of BITUI_TILE x BITUI_TILE pixels. `damage` is an optional bitmap of
+    // BITUI_DAMAGE_SIZE(width, height) bytes with one bit per tile. Without
+    // it, damage is merged into the single bounding box `dirty`.
+    uint8_t *damage;
     bitui_rect_t dirty;
+
+    // When set, primitives, clears and clips are appended to the list with
+    // the color and rop they'd be drawn with, instead of being drawn. Only
+    // the primitives visible in the current clip are recorded.
+    bitui_list_t *list;
 } bitui_ctx_t;
 
+#define BITUI_TILE 8
+#define BITUI_TILES(Pixels) (((Pixels) - 1) / BITUI_TILE + 1)
+#define BITUI_DAMAGE_SIZE(Width, Height) ((BITUI_TILES(Width) * BITUI_TILES(Height) - 1) / 8 + 1)
+
 typedef bitui_ctx_t *bitui_t;
 
 void bitui_clear(bitui_t ctx, bool color);
 
+// Replaces the damage with the tiles whose pixels differ from `previous`,
+// a copy of the framebuffer as it was last flushed, then updates `previous`.
+// Both buffers must be 4-byte aligned. With BITUI_GRAYSCALE, `previous` holds
+// both planes one after the other.
+void bitui_diff_damage(bitui_t ctx, uint8_t *previous);
+
+// Pops the next damaged window, in native framebuffer coordinates and aligned on
+// tiles, and forgets its damage. Returns false once everything was popped.
+bool bitui_next_damage(bitui_t ctx, bitui_rect_t *window);
+
 #ifdef BITUI_ROTATION
 bitui_point_t bitui_apply_rot(bitui_t ctx, bitui_point_t point);
 #endif
 
+// Band rendering: `framebuffer` only holds the framebuffer rows (before
+// rotation) [y, y + h), and every primitive is clipped to them. A frame is
+// rendered once per band, in a buffer of `h * stride` bytes (`h / 8 * width`
+// with BITUI_SWAP_XY, where `y` and `h` are multiples of 8). `h` 0 goes back
+// to the whole framebuffer. Must be called outside of any clip.
+void bitui_set_band(bitui_t ctx, uint16_t y, uint16_t h);
+
+// Restricts every primitive to `rect`, within the current clip, until the
+// matching bitui_pop_clip. Returns false (and pushes nothing) when the stack
+// is full. While recording, the last level is kept for bitui_replay.
+bool bitui_push_clip(bitui_t ctx, bitui_rect_t rect);
+void bitui_pop_clip(bitui_t ctx);
+
+// Lines include both end points. Like every other primitive, coordinates are
+// rotated by `ctx->rot` (a rotated hline is drawn as a native vline).
 void bitui_hline(bitui_t ctx, uint16_t y, uint16_t x1, uint16_t x2);
 void bitui_vline(bitui_t ctx, uint16_t x, uint16_t y1, uint16_t y2);
 
 void bitui_point(bitui_t ctx, uint16_t x, uint16_t y);
+// Any slope. Lines that are not axis aligned use integer Bresenham.
 void bitui_line(bitui_t ctx, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2);
+// Connects `count` points with lines, for sparklines and curves.
+void bitui_polyline(bitui_t ctx, const bitui_point_t *points, uint16_t count);
 
 void bitui_rect(bitui_t ctx, bitui_rect_t rect);
-void bitui_rrect(bitui_t ctx, bitui_rect_t rect, bitui_rect_t radius);
+void bitui_rrect(bitui_t ctx, bitui_rect_t rect, uint16_t radius);
+
+// Filled shapes write whole bytes at once, only their edges are masked.
+void bitui_fill_rect(bitui_t ctx, bitui_rect_t rect);
+void bitui_fill_rrect(bitui_t ctx, bitui_rect_t rect, uint16_t radius);
+
+// Replaces the pixels of `rect` with the ones of `src`, a framebuffer of the
+// whole screen with the same layout, whatever `color` and `rop`. With
+// BITUI_GRAYSCALE, `src` holds both planes one after the other. `src` must
+// outlive the display lists that record the copy.
+void bitui_copy_rect(bitui_t ctx, const uint8_t *src, bitui_rect_t rect);
 
+// Blits draw the set bits of their source, the unset ones are left untouched.
+// `bitui_paste_bitmap` rows start on a new byte, `bitui_paste_bitstream` rows
+// follow each other without padding.
 void bitui_paste_bitmap(bitui_t ctx, const uint8_t *src_bitmap, uint16_t src_w, uint16_t src_h, uint16_t dst_x, uint16_t dst_y);
 void bitui_paste_bitstream(bitui_t ctx, const uint8_t *src_bitstream, uint16_t src_w, uint16_t src_h, uint16_t dst_x, uint16_t dst_y);
+
+typedef enum {
+    BITUI_RUNS_ROWS, // Each row starts on a new byte, MSB is the leftmost pixel
+    BITUI_RUNS_COLS, // Each column starts on a new byte, MSB is the topmost pixel
+} bitui_runs_t;
+
+// Pastes a bitmap made of byte-aligned runs of pixels (see
+// components/gui/tools/glyphconv.py). When the runs follow the framebuffer's
+// byte axis, every source byte is copied with shifted stores instead of being
+// decoded pixel by pixel.
+void bitui_paste_runs(bitui_t ctx, bitui_runs_t layout, const uint8_t *src_runs, uint16_t src_w, uint16_t src_h, uint16_t dst_x, uint16_t dst_y);
+
+#define BITUI_PACKED_MAX_RUN 256
+
+// Same as `bitui_paste_runs` for glyphs packed as run lengths by
+// `glyphconv.py --packed`. Runs are decoded one at a time into a small buffer
+// and blitted right away, runs longer than BITUI_PACKED_MAX_RUN pixels are
+// ignored (glyphconv.py keeps such glyphs plain).
+void bitui_paste_packed_runs(bitui_t ctx, bitui_runs_t layout, const uint8_t *src_packed, uint16_t src_w, uint16_t src_h, uint16_t dst_x, uint16_t dst_y);
+
+// Empties `list`, to record a new frame.
+void bitui_list_reset(bitui_list_t *list);
+
+// Draws the primitives recorded in `list` again, restricted to `rect` within
+// the current clip (for example a band, or a damaged window), without running
+// the code that recorded them.
+void bitui_replay(bitui_t ctx, const bitui_list_t *list, bitui_rect_t rect);
@@ -1,8 +1,8 @@
 #include "gui.h"
 
 #include <assert.h>
-#include <float.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "gfxfont.h"
 #define PROGMEM
@@ -10,8 +10,15 @@
 #include "DigitalDisco16pt7b.h"
 #include "Blocktopia8pt7b.h"
 #include "Icons.h"
-#define FONT_BIG DigitalDisco16pt7b
-#define FONT_SMALL Blocktopia8pt7b
+// Generated at build time by tools/glyphconv.py
+#include "MeteoconsRuns.h"
+#include "DigitalDisco16pt7bRuns.h"
+#include "Blocktopia8pt7bRuns.h"
+#include "IconsRuns.h"
+#define FONT_BIG DigitalDisco16pt7bRuns
+#define FONT_SMALL Blocktopia8pt7bRuns
+#define METEOCONS MeteoconsRuns
+#define ICONS IconsRuns
 
 typedef enum : uint16_t {
     LAYOUT_HORIZONTAL,
@@ -45,7 +52,189 @@ struct size {
 #define MIN(A,B) (((A) < (B)) ? (A) : (B))
 #define MAX(A,B) (((A) > (B)) ? (A) : (B))
 
-static struct size measure_text(const GFXfont *font, const char *str) {
+/* Layout
+ *
+ * The boxes of the home widgets and the frames drawn in them, per panel. They
+ * are integer constants, checked below at compile time: a widget clears and
+ * redraws its box, so boxes must not overlap.
+ */
+
+// The date and time sit LAYOUT_TIME_TOP below the box, plus half a line. The
+// forecast has a column per hour, a gap apart, with PADDING between its rows.
+#if GUI_PANEL == GUI_PANEL_290
+#define LAYOUT_TIME_H 39
+#define LAYOUT_TIME_TOP 12
+#define LAYOUT_GRAPH_H 60
+#define LAYOUT_GRAPH_BAR_PITCH 4
+#define LAYOUT_WEATHER_COL_W 32
+#define LAYOUT_WEATHER_COL_H 54
+#define LAYOUT_WEATHER_GAP 3
+#define LAYOUT_WEATHER_PADDING 4
+#elif GUI_PANEL == GUI_PANEL_397
+#define LAYOUT_TIME_H 48
+#define LAYOUT_TIME_TOP 14
+#define LAYOUT_GRAPH_H 160
+#define LAYOUT_GRAPH_BAR_PITCH 9
+#define LAYOUT_WEATHER_COL_W 40
+#define LAYOUT_WEATHER_COL_H 80
+#define LAYOUT_WEATHER_GAP 4
+#define LAYOUT_WEATHER_PADDING 10
+#endif
+#define LAYOUT_GRAPH_W (SCREEN_ROWS / 3)
+#define LAYOUT_WEATHER_Y (LAYOUT_TIME_H + LAYOUT_GRAPH_H)
+
+// Name, x, y, w, h
+#define LAYOUT_BOXES(X) \
+    X(TIME,    0,                  0,                SCREEN_ROWS,    LAYOUT_TIME_H) \
+    X(TEMP,    0 * LAYOUT_GRAPH_W, LAYOUT_TIME_H,    LAYOUT_GRAPH_W, LAYOUT_GRAPH_H) \
+    X(HUM,     1 * LAYOUT_GRAPH_W, LAYOUT_TIME_H,    LAYOUT_GRAPH_W, LAYOUT_GRAPH_H) \
+    X(CO2,     2 * LAYOUT_GRAPH_W, LAYOUT_TIME_H,    LAYOUT_GRAPH_W, LAYOUT_GRAPH_H) \
+    X(WEATHER, 0,                  LAYOUT_WEATHER_Y, SCREEN_ROWS,    SCREEN_COLS - LAYOUT_WEATHER_Y)
+
+// Name, box, and the space left above and below the frame. Frames are 1px
+// narrower than their box on each side; the label of the outline sits above.
+#define LAYOUT_FRAMES(X) \
+    X(TEMP,    TEMP,    13, 3) \
+    X(HUM,     HUM,     13, 3) \
+    X(CO2,     CO2,     13, 3) \
+    X(WEATHER, WEATHER, 15, 1)
+
+// Height of an outline over its frame, see draw_widget_outline
+#define LAYOUT_OUTLINE_TOP 8
+
+#define LAYOUT_BOX_ENUM(Name, X, Y, W, H) \
+    BOX_##Name##_X = (X), BOX_##Name##_Y = (Y), BOX_##Name##_W = (W), BOX_##Name##_H = (H),
+#define LAYOUT_FRAME_ENUM(Name, Box, Top, Bottom) \
+    FRAME_##Name##_X = BOX_##Box##_X + 1, FRAME_##Name##_Y = BOX_##Box##_Y + (Top), \
+    FRAME_##Name##_W = BOX_##Box##_W - 2, FRAME_##Name##_H = BOX_##Box##_H - (Top) - (Bottom),
+enum { LAYOUT_BOXES(LAYOUT_BOX_ENUM) LAYOUT_FRAMES(LAYOUT_FRAME_ENUM) };
+
+#define LAYOUT_RECT(Kind, Name) \
+    ((bitui_rect_t){ .x = Kind##_##Name##_X, .y = Kind##_##Name##_Y, .w = Kind##_##Name##_W, .h = Kind##_##Name##_H })
+#define LAYOUT_BOX(Name) LAYOUT_RECT(BOX, Name)
+#define LAYOUT_FRAME(Name) LAYOUT_RECT(FRAME, Name)
+
+#define LAYOUT_CHECK_BOX(Name, X, Y, W, H) \
+    _Static_assert(BOX_##Name##_X + BOX_##Name##_W <= SCREEN_ROWS && BOX_##Name##_Y + BOX_##Name##_H <= SCREEN_COLS, \
+                   "Box " #Name " is off screen");
+#define LAYOUT_CHECK_FRAME(Name, Box, Top, Bottom) \
+    _Static_assert((Top) >= LAYOUT_OUTLINE_TOP && FRAME_##Name##_H > 0, "Frame " #Name " leaves its box");
+LAYOUT_BOXES(LAYOUT_CHECK_BOX)
+LAYOUT_FRAMES(LAYOUT_CHECK_FRAME)
+
+#define LAYOUT_DISJOINT(A, B) \
+    _Static_assert(BOX_##A##_X + BOX_##A##_W <= BOX_##B##_X || BOX_##B##_X + BOX_##B##_W <= BOX_##A##_X \
+                   || BOX_##A##_Y + BOX_##A##_H <= BOX_##B##_Y || BOX_##B##_Y + BOX_##B##_H <= BOX_##A##_Y, \
+                   "Boxes " #A " and " #B " overlap")
+LAYOUT_DISJOINT(TIME, TEMP);
+LAYOUT_DISJOINT(TIME, HUM);
+LAYOUT_DISJOINT(TIME, CO2);
+LAYOUT_DISJOINT(TIME, WEATHER);
+LAYOUT_DISJOINT(TEMP, HUM);
+LAYOUT_DISJOINT(TEMP, CO2);
+LAYOUT_DISJOINT(TEMP, WEATHER);
+LAYOUT_DISJOINT(HUM, CO2);
+LAYOUT_DISJOINT(HUM, WEATHER);
+LAYOUT_DISJOINT(CO2, WEATHER);
+
+static uint32_t gui_hash(uint32_t hash, const void *bytes, size_t len) {
+    // FNV-1a
+    for (const uint8_t *b = bytes; len--; ++b)
+        hash = (hash ^ *b) * 16777619u;
+    return hash;
+}
+#define GUI_HASH_INIT 2166136261u
+#define GUI_HASH(Hash, Value) gui_hash((Hash), &(Value), sizeof(Value))
+
+/* Text layout cache
+ *
+ * Labels are measured then rendered, and most of them come back on the next
+ * frame. The glyphs of the last TEXT_CACHE_SIZE strings measured are kept with
+ * their position, least recently used first out. Strings that are only rendered
+ * aren't inserted, so they don't evict the others. The cache belongs to the gui
+ * task: code running elsewhere measures with measure_text_uncached.
+ */
+
+#define TEXT_CACHE_SIZE 16
+#define TEXT_CACHE_MAX_LEN 24 // Longer strings aren't cached
+
+typedef struct {
+    uint8_t glyph; // Index in font->glyph
+    int16_t x, y;  // Top left corner, from the bottom left of the text
+} text_glyph_t;
+
+typedef struct {
+    const GFXfont *font;
+    uint32_t hash;
+    uint32_t last_used;
+    char str[TEXT_CACHE_MAX_LEN + 1];
+    struct size size;
+    uint8_t count;
+    text_glyph_t glyphs[TEXT_CACHE_MAX_LEN];
+} text_layout_t;
+
+static text_layout_t text_cache[TEXT_CACHE_SIZE];
+static uint32_t text_cache_clock;
+
+static void layout_text_into(text_layout_t *layout, const GFXfont *font, const char *str) {
+    layout->size = (struct size){ .w = 0, .h = *str ? font->yAdvance : 0 };
+    layout->count = 0;
+
+    int16_t x = 0, y = 0;
+    for (; *str; ++str) {
+        const char c = *str;
+        if (c == '\n') {
+            layout->size.h += font->yAdvance;
+            layout->size.w = MAX(layout->size.w, x);
+            x = 0;
+            y += font->yAdvance;
+            continue;
+        }
+
+        assert(c >= font->first && c <= font->last);
+        const GFXglyph *glyph = &font->glyph[c - font->first];
+        layout->glyphs[layout->count++] = (text_glyph_t){
+            .glyph = c - font->first,
+            .x = x + glyph->xOffset,
+            .y = y + glyph->yOffset,
+        };
+        x += glyph->xAdvance;
+    }
+    layout->size.w = MAX(layout->size.w, x);
+}
+
+// Layout of `str`, from the cache or, with `insert`, computed into its least
+// recently used entry. NULL when `str` isn't cached and wasn't inserted, or is
+// too long to be cached.
+static const text_layout_t *layout_text(const GFXfont *font, const char *str, bool insert) {
+    const size_t len = strlen(str);
+    if (len > TEXT_CACHE_MAX_LEN)
+        return NULL;
+
+    const uint32_t hash = gui_hash(GUI_HASH_INIT, str, len);
+    text_layout_t *oldest = &text_cache[0];
+    for (size_t i = 0; i < TEXT_CACHE_SIZE; ++i) {
+        text_layout_t *layout = &text_cache[i];
+        if (layout->font == font && layout->hash == hash && strcmp(layout->str, str) == 0) {
+            layout->last_used = ++text_cache_clock;
+            return layout;
+        }
+        if (layout->last_used < oldest->last_used)
+            oldest = layout;
+    }
+    if (!insert)
+        return NULL;
+
+    oldest->font = font;
+    oldest->hash = hash;
+    oldest->last_used = ++text_cache_clock;
+    memcpy(oldest->str, str, len + 1);
+    layout_text_into(oldest, font, str);
+    return oldest;
+}
+
+// Doesn't touch the cache, see measure_text
+static struct size measure_text_uncached(const GFXfont *font, const char *str) {
     struct size s = { .w = 0, .h = 0 };
     if (*str) s.h = font->yAdvance;
 
@@ -59,7 +248,7 @@ static struct size measure_text(const GFXfont *font, const char *str) {
             continue;
         }
 
-        assert(c >= font->first || c <= font->last);
+        assert(c >= font->first && c <= font->last);
         const GFXglyph *glyph = &font->glyph[c - font->first];
 
         line_width += glyph->xAdvance;
@@ -68,7 +257,37 @@ static struct size measure_text(const GFXfont *font, const char *str) {
     return s;
 }
 
+static struct size measure_text(const GFXfont *font, const char *str) {
+    const text_layout_t *layout = layout_text(font, str, true);
+    if (layout != NULL)
+        return layout->size;
+    return measure_text_uncached(font, str);
+}
+
+static inline void paste_glyph(bitui_t ctx, const GFXfont *font, const GFXglyph *glyph, uint16_t x, uint16_t y) {
+#ifdef BITUI_GLYPH_PACKED
+    if (!(glyph->bitmapOffset & BITUI_GLYPH_PLAIN)) {
+        bitui_paste_packed_runs(ctx, BITUI_GLYPH_RUNS, font->bitmap + glyph->bitmapOffset, glyph->width, glyph->height, x, y);
+        return;
+    }
+    const uint16_t offset = glyph->bitmapOffset & ~BITUI_GLYPH_PLAIN;
+#else
+    const uint16_t offset = glyph->bitmapOffset;
+#endif
+    bitui_paste_runs(ctx, BITUI_GLYPH_RUNS, font->bitmap + offset, glyph->width, glyph->height, x, y);
+}
+
 static void render_text(bitui_t ctx, const GFXfont *font, const char *str, const uint16_t bottom_left_x, const uint16_t bottom_left_y) {
+    // Laying out a string to draw it once costs more than drawing it
+    const text_layout_t *layout = layout_text(font, str, false);
+    if (layout != NULL) {
+        for (uint8_t i = 0; i < layout->count; ++i) {
+            const text_glyph_t *g = &layout->glyphs[i];
+            paste_glyph(ctx, font, &font->glyph[g->glyph], bottom_left_x + g->x, bottom_left_y + g->y);
+        }
+        return;
+    }
+
     uint16_t x = bottom_left_x;
     uint16_t y = bottom_left_y;
     for (; *str; ++str) {
@@ -79,9 +298,9 @@ static void render_text(bitui_t ctx, const GFXfont *font, const char *str, const
             continue;
         }
 
-        assert(c >= font->first || c <= font->last);
+        assert(c >= font->first && c <= font->last);
         const GFXglyph glyph = font->glyph[c - font->first];
-        bitui_paste_bitstream(ctx, font->bitmap + glyph.bitmapOffset, glyph.width, glyph.height, glyph.xOffset + x, y + glyph.yOffset);
+        paste_glyph(ctx, font, &glyph, glyph.xOffset + x, y + glyph.yOffset);
         x += glyph.xAdvance;
     }
 }
@@ -89,21 +308,95 @@ static void render_text(bitui_t ctx, const GFXfont *font, const char *str, const
 static char temp_str[80];
 #define tmp_sprintf(...) (snprintf(temp_str, sizeof(temp_str), __VA_ARGS__), temp_str)
 
+size_t gui_format_fixed(char *out, int32_t value, uint8_t frac_bits, uint8_t decimals) {
+    static const uint16_t POW10[] = { 1, 10, 100, 1000, 10000 };
+    assert(decimals < sizeof(POW10) / sizeof(POW10[0]) && frac_bits < 32);
+
+    // Rounded half away from zero
+    const uint32_t magnitude = value < 0 ? -(uint32_t)value : (uint32_t)value;
+    const uint64_t scaled = ((uint64_t)magnitude * POW10[decimals] + ((1ull << frac_bits) >> 1)) >> frac_bits;
+    assert(scaled <= UINT32_MAX && "too many decimals for this value");
+    uint32_t digits = scaled;
+
+    char reversed[GUI_FIXED_LEN];
+    size_t n = 0;
+    do {
+        if (n == decimals && decimals != 0)
+            reversed[n++] = '.';
+        reversed[n++] = '0' + digits % 10;
+        digits /= 10;
+    } while (digits != 0 || n <= decimals);
+
+    size_t len = 0;
+    if (value < 0)
+        out[len++] = '-';
+    while (n > 0)
+        out[len++] = reversed[--n];
+    out[len] = '\0';
+    return len;
+}
+
+/* Animations
+ *
+ * A screen declares the region that only changes with `data->tick` while it
+ * renders. Once rendered, and while the inputs of the rest of the screen stay
+ * the same, the caller may only redraw that region, see gui_animation.
+ */
+
+static gui_animation_t animation;
+static bool animated = false;
+
+static uint32_t screen_still(const gui_data_t *data);
+
+static void declare_animation(bitui_rect_t rect, uint8_t frames) {
+    animation.rect = rect;
+    animation.frames = frames;
+    animated = true;
+}
+
+bool gui_animation(const gui_data_t *data, gui_animation_t *out) {
+    if (!animated || animation.still != screen_still(data))
+        return false;
+    *out = animation;
+    return true;
+}
+
+#define HOURGLASS_FRAMES 5
+
+// Centered on the screen, its top at `y`
+static void paste_hourglass(bitui_t ctx, const gui_data_t *data, uint16_t y) {
+    bitui_rect_t rect = { .x = UINT16_MAX, .y = y, .w = 0, .h = 0 };
+    uint16_t right = 0;
+    for (int frame = 0; frame < HOURGLASS_FRAMES; ++frame) {
+        const GFXglyph *glyph = &ICONS.glyph[ICON_HOURGLASS_FILLED_20 + frame];
+        const uint16_t x = SCREEN_ROWS / 2 - (glyph->xOffset + glyph->width) / 2;
+        rect.x = MIN(rect.x, x);
+        right = MAX(right, x + glyph->width);
+        rect.h = MAX(rect.h, glyph->height);
+    }
+    rect.w = right - rect.x;
+    declare_animation(rect, HOURGLASS_FRAMES);
+
+    const GFXglyph glyph = ICONS.glyph[ICON_HOURGLASS_FILLED_20 + data->tick % HOURGLASS_FRAMES];
+    paste_glyph(ctx, &ICONS, &glyph, SCREEN_ROWS / 2 - (glyph.xOffset + glyph.width) / 2, y);
+}
+
 static void gui_render_boot(bitui_t ctx, const gui_data_t *data) {
     bitui_clear(ctx, true);
+    ctx->color = false;
 
     const char *title = "Connecting to Wi-Fi";
     struct size s = measure_text(&FONT_BIG, title);
-    uint16_t start_y = ctx->height / 2 - (s.h + 17 + 17) / 2 + s.h;
-    render_text(ctx, &FONT_BIG, title, ctx->width / 2 - s.w / 2, start_y);
+    uint16_t start_y = SCREEN_COLS / 2 - (s.h + 17 + 17) / 2 + s.h;
+    render_text(ctx, &FONT_BIG, title, SCREEN_ROWS / 2 - s.w / 2, start_y);
 
-    const GFXglyph glyph = Icons.glyph[ICON_HOURGLASS_FILLED_20 + data->tick % 5];
-    bitui_paste_bitstream(ctx, Icons.bitmap + glyph.bitmapOffset, glyph.width, glyph.height, ctx->width / 2 - (glyph.xOffset + glyph.width) / 2, start_y + 17);
+    paste_hourglass(ctx, data, start_y + 17);
 }
 
 static void gui_render_wifi_init(bitui_t ctx, const gui_data_t *data) {
     (void)data;
     bitui_clear(ctx, true);
+    ctx->color = false;
 
     esp_netif_ip_info_t ip_info;
     esp_netif_get_ip_info(esp_netif_get_default_netif(), &ip_info);
@@ -119,6 +412,7 @@ static void draw_widget_outline(bitui_t ctx, bitui_rect_t bbox, const char *labe
         PADDING_V = 6,
         PADDING_H = 4,
     };
+    _Static_assert(FONT_HEIGHT/2 + PADDING_V == LAYOUT_OUTLINE_TOP);
 
     bbox.y -= FONT_HEIGHT/2 + PADDING_V;
     bbox.h += FONT_HEIGHT/2 + PADDING_V;
@@ -128,39 +422,76 @@ static void draw_widget_outline(bitui_t ctx, bitui_rect_t bbox, const char *labe
     struct size s = measure_text(&FONT_SMALL, label);
     ctx->color = true;
     bitui_line(ctx, bbox.x + PADDING_H, bbox.y, bbox.x + PADDING_H + PADDING_H / 2 + s.w, bbox.y);
+    ctx->color = false;
     render_text(ctx, &FONT_SMALL, label, bbox.x + PADDING_H + PADDING_H / 2, bbox.y + s.h / 4);
 }
 
+// Index of the first element of `haystack` (sorted) not earlier than `needle`
 static size_t find_closest(const int64_t *haystack, size_t count, int64_t needle) {
-    // TODO: binary search
-    size_t i = 0;
-    while (i < count && haystack[i] < needle) {
-        ++i;
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (haystack[mid] < needle)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
-    return i;
+    return lo;
 }
 
-static bool is_day(const struct Forecast *forecast, int64_t now, int64_t *sun_event_time) {
-    const size_t cur_day = find_closest(forecast->daily.time, FORECAST_DURATION_DAYS, now) - 1;
-    assert(cur_day < FORECAST_DURATION_DAYS && "`now` is somehow earlier than `daily.time[0]`");
+// Called when a forecast is decoded, out of the gui task
+static void measure_label(struct ForecastLabel *label) {
+    const struct size s = measure_text_uncached(&FONT_SMALL, label->text);
+    assert(s.w <= UINT8_MAX && "label is too wide");
+    label->w = s.w;
+}
 
-    const int64_t diff_sunrise = now - forecast->daily.sunrise[cur_day];
-    const int64_t  diff_sunset = now - forecast->daily.sunset [cur_day];
+void gui_index_forecast(struct Forecast *forecast) {
+    struct ForecastIndex *index = &forecast->index;
+    index->is_day = 0;
+
+    // Both arrays are sorted, so the day only moves forward
+    size_t cur_day = 0;
+    for (size_t i = 0; i < FORECAST_HOURLY_POINT_COUNT; i++) {
+        const int64_t now = forecast->hourly.time[i];
+        while (cur_day + 1 < FORECAST_DURATION_DAYS && forecast->daily.time[cur_day + 1] <= now)
+            cur_day++;
+        index->day[i] = cur_day;
+
+        const int64_t diff_sunrise = now - forecast->daily.sunrise[cur_day];
+        const int64_t  diff_sunset = now - forecast->daily.sunset [cur_day];
+
+        // In the following ASCII art:
+        // - The sign of diff_sunrise is to the left, and diff_sunset, to the right.
+        // - `.*^` represents sunrise, and `^*.`, sunset.
+        //
+        // NIGHTNIGHT  .*^  DAYDAYDAYDAYDAY  ^*.  NIGHTNIGHT
+        //     --      0-         +-         +0       ++
+        //             ^^^^^^^^^^^^^^^^^^^^
+        //                   is_day=1
+        // Note that during the day, both substractions have opposite signs.
+        if ((diff_sunrise ^ diff_sunset) < 0)
+            index->is_day |= 1ull << i;
+    }
+    index->sun_event = (index->is_day ^ (index->is_day << 1)) & ~1ull;
 
-    // In the following ASCII art:
-    // - The sign of diff_sunrise is to the left, and diff_sunset, to the right.
-    // - `.*^` represents sunrise, and `^*.`, sunset.
-    //
-    // NIGHTNIGHT  .*^  DAYDAYDAYDAYDAY  ^*.  NIGHTNIGHT
-    //     --      0-         +-         +0       ++
-    //             ^^^^^^^^^^^^^^^^^^^^
-    //                   is_day=1
-    // Note that during the day, both substractions have opposite signs.
-    const bool is_day = (diff_sunrise ^ diff_sunset) < 0;
-    if (sun_event_time)
-        *sun_event_time = is_day ? forecast->daily.sunrise[cur_day]
-            : forecast->daily.sunset[cur_day];
-    return is_day;
+    // Every label the weather widget draws, formatted and measured once
+    struct ForecastView *view = &forecast->view;
+    struct tm timeinfo = { 0 };
+    for (size_t i = 0; i < FORECAST_DURATION_DAYS; i++) {
+        strftime(view->sunrise[i].text, sizeof(view->sunrise[i].text), "%H:%M", localtime_r(&forecast->daily.sunrise[i], &timeinfo));
+        measure_label(&view->sunrise[i]);
+        strftime(view->sunset[i].text, sizeof(view->sunset[i].text), "%H:%M", localtime_r(&forecast->daily.sunset[i], &timeinfo));
+        measure_label(&view->sunset[i]);
+    }
+    for (size_t i = 0; i < FORECAST_HOURLY_POINT_COUNT; i++) {
+        struct ForecastHourView *hour = &view->hourly[i];
+        strftime(hour->hour.text, sizeof(hour->hour.text), "%H:00", localtime_r(&forecast->hourly.time[i], &timeinfo));
+        measure_label(&hour->hour);
+        snprintf(hour->temperature.text, sizeof(hour->temperature.text), "%.1f", forecast->hourly.temperature_2m[i]);
+        measure_label(&hour->temperature);
+        hour->icon = meteocon_from_wmo_code(forecast->hourly.weather_code[i], (index->is_day >> i) & 1);
+    }
 }
 
 static void widget_weather(bitui_t ctx, const gui_data_t *data)
@@ -168,18 +499,17 @@ static void widget_weather(bitui_t ctx, const gui_data_t *data)
     const struct Forecast *forecast = data->forecast;
 
     enum {
-        COL_WIDTH = 32,
-        COL_HEIGHT = 54,
-        PADDING = 4,
-        HOURS_DISPLAYED = (SCREEN_ROWS - 6 - 1) / COL_WIDTH,
-        START_X = 1,
-        START_Y = 114,
+        COL_WIDTH = LAYOUT_WEATHER_COL_W,
+        COL_HEIGHT = LAYOUT_WEATHER_COL_H,
+        PADDING = LAYOUT_WEATHER_PADDING,
+        // As many columns as the frame holds whole
+        HOURS_DISPLAYED = (FRAME_WEATHER_W + LAYOUT_WEATHER_GAP) / (COL_WIDTH + LAYOUT_WEATHER_GAP),
+        // Centered in the frame, so the outer labels keep off its edges
+        START_X = FRAME_WEATHER_X + (FRAME_WEATHER_W - HOURS_DISPLAYED * (COL_WIDTH + LAYOUT_WEATHER_GAP) + LAYOUT_WEATHER_GAP) / 2,
+        START_Y = FRAME_WEATHER_Y + (FRAME_WEATHER_H - COL_HEIGHT) / 2,
         LABEL_INTERVAL = 2,
     };
 
-    ctx->color = true;
-    draw_widget_outline(ctx, (bitui_rect_t){ .x = 1, .y = START_Y, .w = SCREEN_ROWS - 2, .h = SCREEN_COLS-1-START_Y }, "WEATHER");
-
     struct size s;
     if (forecast->updated_at <= 0) {
         const bool is_error = forecast->updated_at < 0;
@@ -193,78 +523,67 @@ static void widget_weather(bitui_t ctx, const gui_data_t *data)
         uint16_t start_y = START_Y + COL_HEIGHT / 2 - (17 + PADDING * 3 + s.h/2) / 2;
         render_text(ctx, &FONT_SMALL, status, SCREEN_ROWS / 2 - s.w / 2, start_y + 17 + PADDING * 3);
 
-        const GFXglyph glyph = Icons.glyph[is_error ? ICON_WARNING : (ICON_HOURGLASS_FILLED_20 + data->tick % 5)];
-        bitui_paste_bitstream(ctx, Icons.bitmap + glyph.bitmapOffset, glyph.width, glyph.height, SCREEN_ROWS / 2 - (glyph.xOffset + glyph.width) / 2, start_y);
+        if (is_error) {
+            const GFXglyph glyph = ICONS.glyph[ICON_WARNING];
+            paste_glyph(ctx, &ICONS, &glyph, SCREEN_ROWS / 2 - (glyph.xOffset + glyph.width) / 2, start_y);
+        } else {
+            paste_hourglass(ctx, data, start_y);
+        }
         return;
     }
 
-    bitlayout_t list = { .dir = LAYOUT_HORIZONTAL, .element_gap = 3, .cursor = { .x = START_X, .y = START_Y + 2 } };
+    bitlayout_t list = { .dir = LAYOUT_HORIZONTAL, .element_gap = LAYOUT_WEATHER_GAP, .cursor = { .x = START_X, .y = START_Y + 2 } };
 
-    time_t now = time(NULL);
+    const time_t now = time(NULL);
     _Static_assert(FORECAST_HOURLY_POINT_COUNT >= HOURS_DISPLAYED);
     size_t cur_hour = find_closest(forecast->hourly.time, FORECAST_HOURLY_POINT_COUNT - HOURS_DISPLAYED, now);
 
     // Calculate the label offset to prevent overlapping text when displaying
     // the exact sunrise/sunset hours.
     int hour_label_offset = 0;
-    int prev_is_day = is_day(forecast, forecast->hourly.time[cur_hour], NULL);
-    for (size_t i = 0; i < HOURS_DISPLAYED; i++) {
-        now = forecast->hourly.time[cur_hour + i];
-        int cur_is_day = is_day(forecast, forecast->hourly.time[cur_hour + i], NULL);
-        if (prev_is_day ^ cur_is_day) {
-            hour_label_offset = LABEL_INTERVAL - i % LABEL_INTERVAL;
-            break;
-        }
-
-        prev_is_day = cur_is_day;
-    }
+    const uint64_t sun_events = (forecast->index.sun_event >> cur_hour) & ((1ull << HOURS_DISPLAYED) - 2);
+    if (sun_events)
+        hour_label_offset = LABEL_INTERVAL - __builtin_ctzll(sun_events) % LABEL_INTERVAL;
 
     bitui_point_t pos;
-    struct tm timeinfo = { 0 };
-    prev_is_day = is_day(forecast, forecast->hourly.time[cur_hour], NULL);
+    const size_t first_hour = cur_hour;
     for (int i = 0; i < HOURS_DISPLAYED; i++, cur_hour++) {
-        int cur_is_day = is_day(forecast, forecast->hourly.time[cur_hour], &now);
-        if (cur_is_day ^ prev_is_day) {
-            strftime(temp_str, sizeof(temp_str), "%H:%M", localtime_r(&now, &timeinfo));
+        const struct ForecastHourView *hour = &forecast->view.hourly[cur_hour];
+        if (cur_hour != first_hour && ((forecast->index.sun_event >> cur_hour) & 1)) {
+            const size_t day = forecast->index.day[cur_hour];
+            const struct ForecastLabel *label = ((forecast->index.is_day >> cur_hour) & 1)
+                ? &forecast->view.sunrise[day] : &forecast->view.sunset[day];
 
             pos = bitlayout_element(&list, (bitui_point_t) { .x = COL_WIDTH, .y = COL_HEIGHT });
-            s = measure_text(&FONT_SMALL, temp_str);
-            pos.y += s.h/2;
-            uint16_t text_x = pos.x + (pos.x + COL_WIDTH / 2 < s.w / 2 ? 2 : COL_WIDTH / 2 - s.w / 2);
-            render_text(ctx, &FONT_SMALL, temp_str, text_x, pos.y);
+            pos.y += FONT_SMALL.yAdvance/2;
+            uint16_t text_x = pos.x + (pos.x + COL_WIDTH / 2 < label->w / 2 ? 2 : COL_WIDTH / 2 - label->w / 2);
+            render_text(ctx, &FONT_SMALL, label->text, text_x, pos.y);
 
             pos.y += PADDING;
-            pos.y += Meteocons.yAdvance;
-            const GFXglyph glyph = Meteocons.glyph[METEOCON_SUNSET_SUNRISE];
-            bitui_paste_bitstream(ctx, Meteocons.bitmap + glyph.bitmapOffset, glyph.width, glyph.height, pos.x + COL_WIDTH / 2 - (glyph.xOffset + glyph.width) / 2, pos.y + glyph.yOffset);
+            pos.y += METEOCONS.yAdvance;
+            const GFXglyph glyph = METEOCONS.glyph[METEOCON_SUNSET_SUNRISE];
+            paste_glyph(ctx, &METEOCONS, &glyph, pos.x + COL_WIDTH / 2 - (glyph.xOffset + glyph.width) / 2, pos.y + glyph.yOffset);
 
             i++;
         }
-        prev_is_day = cur_is_day;
 
         pos = bitlayout_element(&list, (bitui_point_t) { .x = COL_WIDTH, .y = COL_HEIGHT });
 
         pos.y += FONT_SMALL.yAdvance/2;
         if ((i + hour_label_offset) % LABEL_INTERVAL == 0) {
-            now = forecast->hourly.time[cur_hour];
-            strftime(temp_str, sizeof(temp_str), "%H:00", localtime_r(&now, &timeinfo));
-            s = measure_text(&FONT_SMALL, temp_str);
-            uint16_t text_x = pos.x + COL_WIDTH / 2 - s.w / 2;
-            if (text_x > pos.x + COL_WIDTH / 2 + s.w) text_x = pos.x + 2;
-            if (text_x + s.w >= SCREEN_ROWS - 2) text_x -= 3;
-            render_text(ctx, &FONT_SMALL, temp_str, text_x, pos.y);
+            uint16_t text_x = pos.x + COL_WIDTH / 2 - hour->hour.w / 2;
+            if (text_x > pos.x + COL_WIDTH / 2 + hour->hour.w) text_x = pos.x + 2;
+            if (text_x + hour->hour.w >= FRAME_WEATHER_X + FRAME_WEATHER_W - 1) text_x -= 3;
+            render_text(ctx, &FONT_SMALL, hour->hour.text, text_x, pos.y);
         }
 
-        pos.y += PADDING + Meteocons.yAdvance;
-        const enum Meteocon icon = meteocon_from_wmo_code(forecast->hourly.weather_code[cur_hour], cur_is_day);
-        const GFXglyph glyph = Meteocons.glyph[icon];
-        bitui_paste_bitstream(ctx, Meteocons.bitmap + glyph.bitmapOffset, glyph.width, glyph.height, pos.x + COL_WIDTH / 2 - (glyph.xOffset + glyph.width) / 2, pos.y + glyph.yOffset);
+        pos.y += PADDING + METEOCONS.yAdvance;
+        const GFXglyph glyph = METEOCONS.glyph[hour->icon];
+        paste_glyph(ctx, &METEOCONS, &glyph, pos.x + COL_WIDTH / 2 - (glyph.xOffset + glyph.width) / 2, pos.y + glyph.yOffset);
 
-        tmp_sprintf("%.1f", forecast->hourly.temperature_2m[cur_hour]);
-        s = measure_text(&FONT_SMALL, temp_str);
-        pos.y += PADDING + s.h/2;
-        assert(s.w / 2 <= pos.x + COL_WIDTH / 2 && "temp label is too wide");
-        render_text(ctx, &FONT_SMALL, temp_str, pos.x + COL_WIDTH / 2 - s.w / 2, pos.y);
+        pos.y += PADDING + FONT_SMALL.yAdvance/2;
+        assert(hour->temperature.w / 2 <= pos.x + COL_WIDTH / 2 && "temp label is too wide");
+        render_text(ctx, &FONT_SMALL, hour->temperature.text, pos.x + COL_WIDTH / 2 - hour->temperature.w / 2, pos.y);
     }
 }
 
@@ -279,7 +598,7 @@ static void widget_time(bitui_t ctx, const gui_data_t *data)
     strftime(temp_str, sizeof(temp_str), "%A %d %b, %R", &timeinfo);
 
     struct size s = measure_text(&FONT_BIG, temp_str);
-    render_text(ctx, &FONT_BIG, temp_str, SCREEN_ROWS / 2 - s.w / 2, 12 + s.h / 2);
+    render_text(ctx, &FONT_BIG, temp_str, SCREEN_ROWS / 2 - s.w / 2, BOX_TIME_Y + LAYOUT_TIME_TOP + s.h / 2);
 }
 
 enum WidgetGraphKind {
@@ -291,91 +610,90 @@ enum WidgetGraphKind {
 struct WidgetGraphMetadata {
     const char label[5];
     const char unit[4];
+    ulp_sample_metric_t metric;
+    uint8_t frac_bits; // Of the values returned by convert_metric
 };
 
 static struct WidgetGraphMetadata WIDGET_GRAPH_METADATA_BY_KIND[] = {
-    [WIDGET_TEMP_SHOW_TEMP] = { .label = "TEMP", .unit = "C" },
-    [WIDGET_TEMP_SHOW_HUM]  = { .label = "RH",   .unit = "%" },
-    [WIDGET_TEMP_SHOW_CO2]  = { .label = "CO2",  .unit = "ppm" },
+    [WIDGET_TEMP_SHOW_TEMP] = { .label = "TEMP", .unit = "C",   .metric = ULP_SAMPLE_RAW_TEMPERATURE, .frac_bits = 16 },
+    [WIDGET_TEMP_SHOW_HUM]  = { .label = "RH",   .unit = "%",   .metric = ULP_SAMPLE_RAW_HUMIDITY,    .frac_bits = 16 },
+    [WIDGET_TEMP_SHOW_CO2]  = { .label = "CO2",  .unit = "ppm", .metric = ULP_SAMPLE_CO2_PPM,         .frac_bits = 0 },
 };
 
-static inline float extract_from_ulp_sample(const ulp_sample_t *sample, enum WidgetGraphKind kind) {
+// Fixed point, see `WidgetGraphMetadata.frac_bits`
+static inline int32_t convert_metric(enum WidgetGraphKind kind, uint16_t raw) {
+    const sht4x_raw_sample_t sht4x = { .raw_temperature = raw, .raw_humidity = raw };
     switch (kind) {
-    case WIDGET_TEMP_SHOW_TEMP: return sht4x_convert(sample->sht4x_raw_sample).temperature_celcius;
-    case WIDGET_TEMP_SHOW_HUM:  return sht4x_convert(sample->sht4x_raw_sample).relative_humidity;
-    case WIDGET_TEMP_SHOW_CO2:  return sample->co2_ppm;
+    case WIDGET_TEMP_SHOW_TEMP: return sht4x_convert(sht4x).temperature_celcius_q16;
+    case WIDGET_TEMP_SHOW_HUM:  return sht4x_convert(sht4x).relative_humidity_q16;
+    case WIDGET_TEMP_SHOW_CO2:  return raw;
     }
-    return 0.0f;
+    return 0;
 }
 
-static void widget_graph(bitui_t ctx, int screen_idx, const ulp_sample_ringbuf_t *data, enum WidgetGraphKind kind)
+static inline int32_t extract_from_ulp_sample(const ulp_sample_t *sample, enum WidgetGraphKind kind) {
+    return convert_metric(kind, ulp_sample_metric(sample, WIDGET_GRAPH_METADATA_BY_KIND[kind].metric));
+}
+
+static void widget_graph(bitui_t ctx, bitui_rect_t frame, const ulp_sample_ringbuf_t *data, const ulp_sample_bounds_t *bounds, enum WidgetGraphKind kind)
 {
+    // Every graph frame has the same size
     enum {
         MARGIN = 2,
-        WIDTH = (SCREEN_ROWS - 2 * MARGIN) / 3,
-        HEIGHT = 44,
-        START_Y = 52,
-        USABLE_HEIGHT = 32,
-        BARS_COUNT = (WIDTH - 8) / 4 + 1,
+        WIDTH = FRAME_TEMP_W,
+        HEIGHT = FRAME_TEMP_H,
+        USABLE_HEIGHT = HEIGHT - 12,
+        BARS_COUNT = (WIDTH - 8) / LAYOUT_GRAPH_BAR_PITCH + 1,
+        // Widest span of the values, in quarters: the SHT4x temperature range
+        MAX_SPAN = (175 << 16) * 4,
+        // Whether `(USABLE_HEIGHT - 2) * span` fits in 31 bits on this panel
+        SCALE_FITS_32 = MAX_SPAN <= INT32_MAX / (USABLE_HEIGHT - 2),
     };
+    _Static_assert(MAX_SPAN >= (125 << 16) * 4 && MAX_SPAN >= UINT16_MAX * 4, "MAX_SPAN covers every graph kind");
+    _Static_assert(FRAME_HUM_W == FRAME_TEMP_W && FRAME_CO2_W == FRAME_TEMP_W && FRAME_HUM_H == FRAME_TEMP_H && FRAME_CO2_H == FRAME_TEMP_H);
 
     struct size s;
     struct WidgetGraphMetadata metadata = WIDGET_GRAPH_METADATA_BY_KIND[kind];
-    uint16_t start_x = screen_idx * (MARGIN + WIDTH) + 1;
-
-    ctx->color = true;
-    draw_widget_outline(ctx, (bitui_rect_t){ .x = start_x, .y = START_Y, .w = WIDTH, .h = HEIGHT }, metadata.label);
+    const uint16_t start_x = frame.x;
+    const uint16_t start_y = frame.y;
 
     if (data == NULL || data->count == 0) {
         const char *value = tmp_sprintf("? %s", metadata.unit);
         s = measure_text(&FONT_SMALL, value);
-        render_text(ctx, &FONT_SMALL, value, start_x + WIDTH - MARGIN - s.w, START_Y - MARGIN + s.h/2);
+        render_text(ctx, &FONT_SMALL, value, start_x + WIDTH - MARGIN - s.w, start_y - MARGIN + s.h/2);
 
         s = measure_text(&FONT_SMALL, "no history");
-        render_text(ctx, &FONT_SMALL, "no history", start_x + WIDTH / 2 - s.w / 2, START_Y + HEIGHT / 2 - MARGIN + s.h/2);
+        render_text(ctx, &FONT_SMALL, "no history", start_x + WIDTH / 2 - s.w / 2, start_y + HEIGHT / 2 - MARGIN + s.h/2);
         return;
     }
 
     const ulp_sample_t *newest = &data->items[ringbuf_newest(data)];
-    const float cur_val = extract_from_ulp_sample(newest, kind);
-
-    const char *current_val = tmp_sprintf("%.1f %s", cur_val, metadata.unit);
-    s = measure_text(&FONT_SMALL, current_val);
-    render_text(ctx, &FONT_SMALL, current_val, start_x + WIDTH - MARGIN - s.w, START_Y - MARGIN + s.h/2);
-
-    float max_val, min_val;
-    max_val = min_val = cur_val;
-    {
-        // Calculate the min/max values for the last 10 samples
-        enum {
-            MIN_MAX_WINDOW_SIZE = 15,
-        };
-        _Static_assert(MIN_MAX_WINDOW_SIZE <= ringbuf_cap(data));
-
-        const int split_idx = data->count >= MIN_MAX_WINDOW_SIZE ? ringbuf_newest_nth(data, MIN_MAX_WINDOW_SIZE - 1) : 0;
-        for (int i = 0, it = split_idx; i < MIN_MAX_WINDOW_SIZE; i++, it = ringbuf_next(data, it)) {
-            float val = extract_from_ulp_sample(&data->items[it], kind);
-            if (val > max_val) max_val = val;
-            if (val < min_val) min_val = val;
-        }
-
-        float max_rem, min_rem;
-        max_rem = min_rem = extract_from_ulp_sample(&data->items[data->start], kind);
-        // Calculate separate min/max for the remaining samples
-        for (int i = ringbuf_next(data, data->start); i != split_idx; i = ringbuf_next(data, i)) {
-            float val = extract_from_ulp_sample(&data->items[i], kind);
-            if (val > max_rem) max_rem = val;
-            if (val < min_rem) min_rem = val;
-        }
-
-        if (max_rem > max_val) max_val += (max_rem - max_val) * 0.25f;
-        if (min_rem < min_val) min_val += (min_rem - min_val) * 0.25f;
+    const int32_t cur_val = extract_from_ulp_sample(newest, kind);
+
+    size_t len = gui_format_fixed(temp_str, cur_val, metadata.frac_bits, 1);
+    temp_str[len++] = ' ';
+    strcpy(&temp_str[len], metadata.unit);
+    s = measure_text(&FONT_SMALL, temp_str);
+    render_text(ctx, &FONT_SMALL, temp_str, start_x + WIDTH - MARGIN - s.w, start_y - MARGIN + s.h/2);
+
+    // Bounds of the newest samples, moved a quarter of the way to the bounds
+    // of the older ones. They are in quarters, so that this stays exact.
+    assert(bounds != NULL && "samples come with their bounds");
+    const ulp_sample_metric_t metric = metadata.metric;
+    int32_t max_val = convert_metric(kind, ulp_sample_deque_front(bounds->metrics[metric].window_max, data, metric)) * 4;
+    int32_t min_val = convert_metric(kind, ulp_sample_deque_front(bounds->metrics[metric].window_min, data, metric)) * 4;
+    if (bounds->metrics[metric].older_max != 0) {
+        const int32_t max_rem = convert_metric(kind, ulp_sample_deque_front(bounds->metrics[metric].older_max, data, metric));
+        const int32_t min_rem = convert_metric(kind, ulp_sample_deque_front(bounds->metrics[metric].older_min, data, metric));
+        if (max_rem * 4 > max_val) max_val += max_rem - max_val / 4;
+        if (min_rem * 4 < min_val) min_val += min_rem - min_val / 4;
     }
 
     // Prevent division by zero at the normalization step
-    if ((max_val - min_val) < FLT_EPSILON) {
-        max_val = cur_val*2;
+    if (max_val == min_val) {
+        max_val = cur_val * 4 * 2;
         min_val = 0;
+        if (max_val == min_val) max_val = 1;
     }
 
     ctx->color = false;
@@ -383,40 +701,217 @@ static void widget_graph(bitui_t ctx, int screen_idx, const ulp_sample_ringbuf_t
     _Static_assert(BARS_COUNT <= ringbuf_cap(data), "Graph must have less (or equal) bars than ringbuf values");
     int it = data->count >= BARS_COUNT ? ringbuf_newest_nth(data, BARS_COUNT-1) : 0;
     int count = data->count >= BARS_COUNT ? BARS_COUNT : data->count;
+    // Samples are joined as a sparkline, broken by the samples in error
+    bitui_point_t curve[BARS_COUNT];
+    int curve_len = 0;
     for (int i = 0; i < count; i++, it = ringbuf_next(data, it)) {
+        const uint16_t x = start_x + (i + 1) * LAYOUT_GRAPH_BAR_PITCH;
         if (ulp_sample_flags_sht4x(data->items[it].flags) != 0) {
-            uint16_t dx = (i + 1) * 4;
-            bitui_line(ctx, start_x + dx    , START_Y + HEIGHT - MARGIN - 14, start_x + dx    , START_Y + HEIGHT - MARGIN - 16);
-            bitui_line(ctx, start_x + dx + 1, START_Y + HEIGHT - MARGIN - 14, start_x + dx + 1, START_Y + HEIGHT - MARGIN - 16);
+            bitui_polyline(ctx, curve, curve_len);
+            curve_len = 0;
+            bitui_fill_rect(ctx, (bitui_rect_t){ .x = x, .y = start_y + HEIGHT - MARGIN - 16, .w = 2, .h = 3 });
             continue;
         }
 
-        float val = extract_from_ulp_sample(&data->items[it], kind);
-        float p = (val - min_val) / (max_val-min_val);
-        if (p < 0) p = 0;
-        if (p > 1) p = 1;
-
-        uint16_t dx = (i + 1) * 4;
-        uint16_t bar_height = (USABLE_HEIGHT - 2) * p + 2;
-        bitui_line(ctx, start_x + dx    , START_Y + HEIGHT - MARGIN, start_x + dx    , START_Y + HEIGHT - MARGIN - bar_height);
-        bitui_line(ctx, start_x + dx + 1, START_Y + HEIGHT - MARGIN, start_x + dx + 1, START_Y + HEIGHT - MARGIN - bar_height);
+        // Normalized to [0, USABLE_HEIGHT - 2] in integers. The 64-bit division
+        // is a libcall, so it is only used by the panels that need it.
+        const int32_t val = extract_from_ulp_sample(&data->items[it], kind) * 4;
+        int32_t scaled;
+        if (SCALE_FITS_32)
+            scaled = (USABLE_HEIGHT - 2) * (val - min_val) / (max_val - min_val);
+        else
+            scaled = (int64_t)(USABLE_HEIGHT - 2) * (val - min_val) / (max_val - min_val);
+        if (scaled < 0) scaled = 0;
+        if (scaled > USABLE_HEIGHT - 2) scaled = USABLE_HEIGHT - 2;
+
+        const uint16_t height = scaled + 2;
+        curve[curve_len++] = (bitui_point_t){ .x = x, .y = start_y + HEIGHT - MARGIN - height + 1 };
     }
+    bitui_polyline(ctx, curve, curve_len);
 }
 
-static void gui_render_home(bitui_t ctx, const gui_data_t *data)
-{
-    bitui_clear(ctx, true);
+/* Home screen
+ *
+ * Widgets are retained between renders into the same framebuffer: each one
+ * hashes the inputs it is drawn from, and is only cleared and redrawn when
+ * they changed. Everything a widget draws must stay within its `bbox`.
+ */
 
-    ctx->color = false;
+typedef struct {
+    bitui_rect_t bbox;
+    uint32_t (*inputs)(const gui_data_t *data, int arg);
+    void (*render)(bitui_t ctx, const gui_data_t *data, int arg);
+    int arg;
+    // Draws what never changes, before `render`. Optional.
+    void (*chrome)(bitui_t ctx, int arg);
+} gui_widget_t;
+
+static uint32_t widget_time_inputs(const gui_data_t *data, int arg) {
+    (void)data; (void)arg;
+    const time_t minute = time(NULL) / 60;
+    return GUI_HASH(GUI_HASH_INIT, minute);
+}
 
-    widget_weather(ctx, data);
+static void widget_time_render(bitui_t ctx, const gui_data_t *data, int arg) {
+    (void)arg;
     widget_time(ctx, data);
+}
+
+static uint32_t widget_weather_inputs(const gui_data_t *data, int arg) {
+    (void)arg;
+    const struct Forecast *forecast = data->forecast;
+    uint32_t hash = GUI_HASH(GUI_HASH_INIT, forecast->updated_at);
+    if (forecast->updated_at == 0) {
+        // Loading animation
+        const uint32_t frame = data->tick % HOURGLASS_FRAMES;
+        hash = GUI_HASH(hash, frame);
+    } else if (forecast->updated_at > 0) {
+        // The columns start at the current hour
+        const size_t cur_hour = find_closest(forecast->hourly.time, FORECAST_HOURLY_POINT_COUNT, time(NULL));
+        hash = GUI_HASH(hash, cur_hour);
+    }
+    return hash;
+}
+
+static void widget_weather_render(bitui_t ctx, const gui_data_t *data, int arg) {
+    (void)arg;
+    widget_weather(ctx, data);
+}
+
+static void widget_weather_chrome(bitui_t ctx, int arg) {
+    (void)arg;
+    draw_widget_outline(ctx, LAYOUT_FRAME(WEATHER), "WEATHER");
+}
+
+static uint32_t widget_graph_inputs(const gui_data_t *data, int arg) {
+    (void)arg;
+    const ulp_sample_ringbuf_t *samples = data->samples;
+    if (samples == NULL || samples->count == 0)
+        return GUI_HASH_INIT;
+
+    // Every push moves the newest sample, whose timestamp is unique
+    uint32_t hash = GUI_HASH(GUI_HASH_INIT, samples->count);
+    hash = GUI_HASH(hash, samples->start);
+    return GUI_HASH(hash, samples->items[ringbuf_newest(samples)]);
+}
+
+static const bitui_rect_t GRAPH_FRAMES[] = {
+    [WIDGET_TEMP_SHOW_TEMP] = LAYOUT_FRAME(TEMP),
+    [WIDGET_TEMP_SHOW_HUM]  = LAYOUT_FRAME(HUM),
+    [WIDGET_TEMP_SHOW_CO2]  = LAYOUT_FRAME(CO2),
+};
+
+static void widget_graph_render(bitui_t ctx, const gui_data_t *data, int arg) {
+    widget_graph(ctx, GRAPH_FRAMES[arg], data->samples, data->bounds, arg);
+}
+
+static void widget_graph_chrome(bitui_t ctx, int arg) {
+    draw_widget_outline(ctx, GRAPH_FRAMES[arg], WIDGET_GRAPH_METADATA_BY_KIND[arg].label);
+}
+
+static const gui_widget_t HOME_WIDGETS[] = {
+    { .bbox = LAYOUT_BOX(TIME),    widget_time_inputs,    widget_time_render,    0, NULL },
+    { .bbox = LAYOUT_BOX(TEMP),    widget_graph_inputs,   widget_graph_render,   WIDGET_TEMP_SHOW_TEMP, widget_graph_chrome },
+    { .bbox = LAYOUT_BOX(HUM),     widget_graph_inputs,   widget_graph_render,   WIDGET_TEMP_SHOW_HUM,  widget_graph_chrome },
+    { .bbox = LAYOUT_BOX(CO2),     widget_graph_inputs,   widget_graph_render,   WIDGET_TEMP_SHOW_CO2,  widget_graph_chrome },
+    { .bbox = LAYOUT_BOX(WEATHER), widget_weather_inputs, widget_weather_render, 0,                     widget_weather_chrome },
+};
+#define HOME_WIDGET_COUNT (sizeof(HOME_WIDGETS) / sizeof(HOME_WIDGETS[0]))
+
+// Inputs of the widgets as they were last drawn, valid when `home_drawn`
+static uint32_t home_hashes[HOME_WIDGET_COUNT];
+static bool home_drawn = false;
 
-    widget_graph(ctx, 0, data->samples, WIDGET_TEMP_SHOW_TEMP);
-    widget_graph(ctx, 1, data->samples, WIDGET_TEMP_SHOW_HUM);
-    widget_graph(ctx, 2, data->samples, WIDGET_TEMP_SHOW_CO2);
+void gui_invalidate(void) {
+    home_drawn = false;
 }
 
+// Layout and framebuffer geometry `data->background` was drawn for, 0 when
+// it wasn't
+static uint32_t background_key = 0;
+
+static uint32_t home_layout_key(bitui_t ctx, const uint8_t *background) {
+    uint32_t hash = GUI_HASH(GUI_HASH_INIT, background);
+    hash = GUI_HASH(hash, ctx->width);
+    hash = GUI_HASH(hash, ctx->height);
+    hash = GUI_HASH(hash, ctx->stride);
+#ifdef BITUI_ROTATION
+    hash = GUI_HASH(hash, ctx->rot);
+#endif
+    for (size_t i = 0; i < HOME_WIDGET_COUNT; ++i)
+        hash = GUI_HASH(hash, HOME_WIDGETS[i].bbox);
+    return hash | 1;
+}
+
+// Chrome of every widget on a white screen, drawn once into
+// `data->background`. NULL without a background.
+static const uint8_t *home_background(bitui_t ctx, const gui_data_t *data) {
+    if (data->background == NULL)
+        return NULL;
+
+    const uint32_t key = home_layout_key(ctx, data->background);
+    if (key == background_key)
+        return data->background;
+
+    bitui_ctx_t background = {
+        .width = ctx->width,
+        .height = ctx->height,
+        .stride = ctx->stride,
+        .framebuffer = data->background,
+#ifdef BITUI_GRAYSCALE
+        .framebuffer_hi = data->background + GUI_BACKGROUND_SIZE / 2,
+#endif
+#ifdef BITUI_ROTATION
+        .rot = ctx->rot,
+#endif
+    };
+    bitui_clear(&background, true);
+    for (size_t i = 0; i < HOME_WIDGET_COUNT; ++i) {
+        if (HOME_WIDGETS[i].chrome) {
+            background.color = false;
+            HOME_WIDGETS[i].chrome(&background, HOME_WIDGETS[i].arg);
+        }
+    }
+    background_key = key;
+    return data->background;
+}
+
+static void gui_render_home(bitui_t ctx, const gui_data_t *data)
+{
+    // The whole screen, within the clips of bitui
+    const bitui_rect_t screen = { .x = 0, .y = 0, .w = UINT16_MAX, .h = UINT16_MAX };
+    const uint8_t *background = home_background(ctx, data);
+
+    // Display lists and bands don't hold the previous frame
+    const bool retained = home_drawn && ctx->list == NULL && ctx->band_h == 0;
+    if (!retained) {
+        if (background)
+            bitui_copy_rect(ctx, background, screen);
+        else
+            bitui_clear(ctx, true);
+    }
+
+    for (size_t i = 0; i < HOME_WIDGET_COUNT; ++i) {
+        const gui_widget_t *widget = &HOME_WIDGETS[i];
+        const uint32_t hash = widget->inputs(data, widget->arg);
+        if (retained) {
+            if (hash == home_hashes[i])
+                continue;
+            if (background) {
+                bitui_copy_rect(ctx, background, widget->bbox);
+            } else {
+                ctx->color = true;
+                bitui_fill_rect(ctx, widget->bbox);
+            }
+        }
+        ctx->color = false;
+        if (background == NULL && widget->chrome)
+            widget->chrome(ctx, widget->arg);
+        widget->render(ctx, data, widget->arg);
+        home_hashes[i] = hash;
+    }
+    home_drawn = ctx->list == NULL && ctx->band_h == 0;
+}
 typedef void (*gui_screeen_renderer_t)(bitui_t ctx, const gui_data_t *data);
 
 const gui_screeen_renderer_t GUI_SCREEN_RENDERERERS[GUI_COUNT] = {
@@ -425,7 +920,53 @@ const gui_screeen_renderer_t GUI_SCREEN_RENDERERERS[GUI_COUNT] = {
     [GUI_HOME] = gui_render_home,
 };
 
+static uint32_t screen_still(const gui_data_t *data) {
+    // Whatever the frame, the animations draw their first one
+    gui_data_t still = *data;
+    still.tick = 0;
+
+    uint32_t hash = GUI_HASH(GUI_HASH_INIT, still.current_screen);
+    if (still.current_screen == GUI_HOME) {
+        for (size_t i = 0; i < HOME_WIDGET_COUNT; ++i) {
+            const uint32_t inputs = HOME_WIDGETS[i].inputs(&still, HOME_WIDGETS[i].arg);
+            hash = GUI_HASH(hash, inputs);
+        }
+    }
+    return hash;
+}
+
+uint32_t gui_frame_key(const gui_data_t *data) {
+    uint32_t hash = GUI_HASH(GUI_HASH_INIT, data->current_screen);
+    switch (data->current_screen) {
+    case GUI_BOOT: {
+        const uint32_t frame = data->tick % HOURGLASS_FRAMES;
+        hash = GUI_HASH(hash, frame);
+        break;
+    }
+    case GUI_HOME:
+        hash = GUI_HASH(hash, data->background);
+        for (size_t i = 0; i < HOME_WIDGET_COUNT; ++i) {
+            const uint32_t inputs = HOME_WIDGETS[i].inputs(data, HOME_WIDGETS[i].arg);
+            hash = GUI_HASH(hash, inputs);
+        }
+        break;
+    default:
+        // Drawn from state out of `data` (the IP address)
+        return 0;
+    }
+    return hash ? hash : 1;
+}
+
 void gui_render(bitui_t ctx, const gui_data_t *data)
 {
+    // Only the home screen is retained, other screens draw over it
+    if (data->current_screen != GUI_HOME)
+        gui_invalidate();
+
+    // Retained widgets that aren't redrawn keep their animation
+    const uint32_t still = screen_still(data);
+    if (animation.still != still)
+        animated = false;
     GUI_SCREEN_RENDERERERS[data->current_screen](ctx, data);
+    animation.still = still;
 }
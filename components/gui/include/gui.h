@@ -7,9 +7,32 @@
 #include <time.h>
 #include <esp_netif.h>
 
+// Panels the layouts are made for, picked at build time with GUI_PANEL. The
+// ssd1680 driver only drives the 2.9" one for now.
+#define GUI_PANEL_290 0 // 168x384, SSD1685
+#define GUI_PANEL_397 1 // 480x800, GDEM0397T81P
+#ifndef GUI_PANEL
+#define GUI_PANEL GUI_PANEL_290
+#endif
+
+#if GUI_PANEL == GUI_PANEL_290
 #define SCREEN_COLS 168
 #define SCREEN_ROWS 384
+#elif GUI_PANEL == GUI_PANEL_397
+#define SCREEN_COLS 480
+#define SCREEN_ROWS 800
+#else
+#error "Unknown GUI_PANEL"
+#endif
 #define SCREEN_STRIDE ((SCREEN_COLS - 1) / 8 + 1)
+#ifndef BITUI_GRAYSCALE
+#define GUI_BACKGROUND_SIZE (SCREEN_STRIDE * SCREEN_ROWS)
+#else
+#define GUI_BACKGROUND_SIZE (2 * SCREEN_STRIDE * SCREEN_ROWS)
+#endif
+// Size of a bitui_list_t that holds any screen (3.2 KB at most, measured with
+// `headless --bands` and 64-bit pointers)
+#define GUI_LIST_SIZE 4096
 
 #define FORECAST_DURATION_DAYS 2
 #define FORECAST_HOURLY_POINT_COUNT FORECAST_DURATION_DAYS * 24
@@ -29,9 +52,29 @@ struct Forecast {
         int64_t sunset[FORECAST_DURATION_DAYS];
     } daily;
     time_t updated_at;
+    // Filled by gui_index_forecast, bit i is hourly.time[i]
+    struct ForecastIndex {
+        uint64_t is_day;
+        // Sunrise or sunset between hourly.time[i - 1] and hourly.time[i]
+        uint64_t sun_event;
+        // Day of hourly.time[i] in `daily`
+        uint8_t day[FORECAST_HOURLY_POINT_COUNT];
+    } index;
+    // Filled by gui_index_forecast: what the weather widget draws
+    struct ForecastView {
+        struct ForecastLabel {
+            char text[6];
+            uint8_t w; // In the small font
+        } sunrise[FORECAST_DURATION_DAYS], sunset[FORECAST_DURATION_DAYS];
+        struct ForecastHourView {
+            struct ForecastLabel hour, temperature;
+            uint8_t icon; // enum Meteocon
+        } hourly[FORECAST_HOURLY_POINT_COUNT];
+    } view;
 };
 _Static_assert(sizeof(((struct Forecast*)NULL)->hourly.time[0]) == sizeof(time_t));
 _Static_assert(sizeof(((struct Forecast*)NULL)->daily.time[0]) == sizeof(time_t));
+_Static_assert(FORECAST_HOURLY_POINT_COUNT <= 64, "ForecastIndex bitmasks are too small");
 
 typedef enum {
     GUI_BOOT = 0,
@@ -47,6 +90,42 @@ typedef struct {
     // Home screen
     const struct Forecast *forecast;
     const ulp_sample_ringbuf_t *samples;
+    const ulp_sample_bounds_t *bounds; // Of `samples`
+    // Optional, GUI_BACKGROUND_SIZE bytes kept for the GUI: the parts of the
+    // home screen that never change are drawn there once, then copied
+    uint8_t *background;
 } gui_data_t;
 
+// Draws the current screen. The home screen only redraws the widgets whose
+// inputs changed since the last frame drawn in the same framebuffer, unless
+// `ctx` records a display list or draws a band.
 void gui_render(bitui_t ctx, const gui_data_t *data);
+// Redraws everything on the next gui_render, after the framebuffer was
+// cleared or drawn by something else.
+void gui_invalidate(void);
+// Hash of everything the frame gui_render draws for `data` depends on: two
+// frames with the same key are the same, a display list recorded for one
+// can be replayed for the other. 0 when the screen can't tell.
+uint32_t gui_frame_key(const gui_data_t *data);
+// Longest output of gui_format_fixed, terminator included
+#define GUI_FIXED_LEN 13
+// Writes `value`, with `frac_bits` fractional bits, rounded to `decimals` (at
+// most 4) digits after the point, like "%.<decimals>f" but without floats.
+// Returns the length written.
+size_t gui_format_fixed(char *out, int32_t value, uint8_t frac_bits, uint8_t decimals);
+// A region of the current screen that only changes with `data->tick`: it
+// shows frame `tick % frames`.
+typedef struct {
+    bitui_rect_t rect;
+    uint8_t frames;
+    // Inputs of the rest of the screen, that stays the same while they do
+    uint32_t still;
+} gui_animation_t;
+
+// Whether the screen last drawn by gui_render animates a region, and `data`
+// only changes that region's frame. The caller may then update the region
+// alone, with frames captured from earlier renders.
+bool gui_animation(const gui_data_t *data, gui_animation_t *animation);
+// Builds `forecast->index` and `forecast->view`, once per forecast, before it
+// is rendered.
+void gui_index_forecast(struct Forecast *forecast);
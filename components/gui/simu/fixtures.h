@@ -0,0 +1,11 @@
+#pragma once
+
+#include "gui.h"
+
+// Sample data shared by the simulator and the headless renderer. The
+// forecast covers 2025-08-10 and 2025-08-11 (UTC), its index is built with
+// gui_index_forecast.
+extern struct Forecast g_forecast;
+extern ulp_sample_ringbuf_t g_ulp_samples;
+// Of g_ulp_samples, built with ulp_sample_bounds_rebuild
+extern ulp_sample_bounds_t g_ulp_bounds;
@@ -0,0 +1,286 @@
+// Renders the gui screens with the simulator's fixtures, without a window.
+//
+// Every case is rendered a few times to time `gui_render`, then written as
+// PBM (or PNG) and/or compared against the golden PBM of the same name.
+// Goldens are regenerated with `make golden` after an intended change.
+//
+// With `--bands ROWS`, every frame is recorded once into a display list then
+// replayed ROWS framebuffer rows at a time, like the device's band mode, and
+// must still match the goldens.
+//
+// With `--background`, the home screen copies its chrome from a background
+// drawn once, like the device's full-frame mode.
+//
+// Built with BITUI_GRAYSCALE (`headless_gray`), the screens are drawn on two
+// planes. They only use black and white, so both planes must be the same.
+//
+// Usage: headless [-o DIR] [--png] [--golden DIR] [--update DIR] [--bands ROWS] [--background] [case...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gui.h"
+#include "bitui.h"
+#include "fixtures.h"
+#include "image.h"
+
+#define RENDER_RUNS 20
+
+// Pinned clock, in the middle of the fixture forecast, so that renders don't
+// depend on when they are made.
+#define FIXTURE_NOW 1754820000
+time_t time(time_t *t) {
+    if (t) *t = FIXTURE_NOW;
+    return FIXTURE_NOW;
+}
+
+typedef struct {
+    const char *name;
+    gui_screen_t screen;
+    uint32_t tick;
+    time_t updated_at; // Forecast state, see `struct Forecast`
+    bool samples;
+} render_case_t;
+
+static const render_case_t cases[] = {
+    { "boot",           GUI_BOOT,      1,  1,     true },
+    { "wifi",           GUI_WIFI_INIT, 0,  1,     true },
+    { "home",           GUI_HOME,      0,  1,     true },
+    { "home_loading",   GUI_HOME,      2,  0,     true },
+    { "home_error",     GUI_HOME,      0, -0x42,  true },
+    { "home_nosamples", GUI_HOME,      0,  1,     false },
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// Renders `data` band by band from a display list, each band drawn in place
+// in `framebuffer`. Returns the size of the list.
+static uint16_t render_bands(bitui_t ctx, const gui_data_t *data, uint16_t band_rows) {
+    static uint8_t ops[GUI_LIST_SIZE] __attribute__((aligned(2)));
+    bitui_list_t list = { .ops = ops, .capacity = sizeof(ops) };
+    uint8_t *framebuffer = ctx->framebuffer;
+#ifdef BITUI_GRAYSCALE
+    uint8_t *framebuffer_hi = ctx->framebuffer_hi;
+#endif
+
+    ctx->list = &list;
+    gui_render(ctx, data);
+    ctx->list = NULL;
+    if (list.overflow) {
+        fprintf(stderr, "Display list overflow, GUI_LIST_SIZE is too small\n");
+        exit(1);
+    }
+
+    const bitui_point_t size = image_size(ctx);
+    for (uint16_t y = 0; y < ctx->height; y += band_rows) {
+        const uint16_t rows = ctx->height - y < band_rows ? ctx->height - y : band_rows;
+        bitui_set_band(ctx, y, rows);
+#ifdef BITUI_SWAP_XY
+        const size_t offset = y / 8 * ctx->width;
+#else
+        const size_t offset = (size_t)y * ctx->stride;
+#endif
+        ctx->framebuffer = framebuffer + offset;
+#ifdef BITUI_GRAYSCALE
+        ctx->framebuffer_hi = framebuffer_hi + offset;
+#endif
+        bitui_replay(ctx, &list, (bitui_rect_t){ .x = 0, .y = 0, .w = size.x, .h = size.y });
+    }
+    bitui_set_band(ctx, 0, 0);
+    ctx->framebuffer = framebuffer;
+#ifdef BITUI_GRAYSCALE
+    ctx->framebuffer_hi = framebuffer_hi;
+#endif
+    return list.len;
+}
+
+static bool selected(const char *name, int argc, char *argv[]) {
+    if (argc == 0)
+        return true;
+    for (int i = 0; i < argc; ++i)
+        if (strcmp(argv[i], name) == 0)
+            return true;
+    return false;
+}
+
+// Returns the number of pixels that differ from the golden, or -1 when the
+// golden can't be read or doesn't have the same size.
+static long compare_golden(const char *path, const char *pbm, size_t pbm_len) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return -1;
+
+    char *golden = malloc(pbm_len);
+    const size_t golden_len = fread(golden, 1, pbm_len, f);
+    const bool longer = fgetc(f) != EOF;
+    fclose(f);
+
+    // The headers are the same when the sizes are, rows are padded with 0
+    long diff = -1;
+    if (golden_len == pbm_len && !longer) {
+        diff = 0;
+        for (size_t i = 0; i < pbm_len; ++i)
+            diff += __builtin_popcount((uint8_t)(golden[i] ^ pbm[i]));
+    }
+    free(golden);
+    return diff;
+}
+
+static bool write_file(const char *path, const char *data, size_t len) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+    fwrite(data, 1, len, f);
+    return fclose(f) == 0;
+}
+
+int main(int argc, char **argv) {
+    const char *out_dir = NULL, *golden_dir = NULL, *update_dir = NULL;
+    bool png = false;
+    int band_rows = 0;
+    static uint8_t background[GUI_BACKGROUND_SIZE];
+    bool use_background = false;
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out_dir = argv[++i];
+        } else if (strcmp(argv[i], "--png") == 0) {
+            png = true;
+        } else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+            golden_dir = argv[++i];
+        } else if (strcmp(argv[i], "--update") == 0 && i + 1 < argc) {
+            update_dir = argv[++i];
+        } else if (strcmp(argv[i], "--bands") == 0 && i + 1 < argc) {
+            band_rows = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--background") == 0) {
+            use_background = true;
+        } else {
+            fprintf(stderr, "Usage: %s [-o DIR] [--png] [--golden DIR] [--update DIR] [--bands ROWS] [--background] [case...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    setenv("TZ", "UTC", 1);
+    tzset();
+    gui_index_forecast(&g_forecast);
+    ulp_sample_bounds_rebuild(&g_ulp_bounds, &g_ulp_samples);
+
+    static uint8_t framebuffer[SCREEN_STRIDE * SCREEN_ROWS];
+#ifdef BITUI_GRAYSCALE
+    static uint8_t framebuffer_hi[sizeof(framebuffer)];
+#endif
+    static bitui_ctx_t bitui_handle = (bitui_ctx_t){
+        .width = SCREEN_COLS,
+        .height = SCREEN_ROWS,
+        .stride = SCREEN_STRIDE,
+        .framebuffer = framebuffer,
+#ifdef BITUI_GRAYSCALE
+        .framebuffer_hi = framebuffer_hi,
+#endif
+#ifdef BITUI_ROTATION
+        .rot = BITUI_ROT_090,
+#endif
+        .color = true,
+    };
+    bitui_t ctx = &bitui_handle;
+
+    int failures = 0;
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+        const render_case_t *rc = &cases[c];
+        if (!selected(rc->name, argc - i, argv + i))
+            continue;
+
+        g_forecast.updated_at = rc->updated_at;
+        const gui_data_t data = {
+            .current_screen = rc->screen,
+            .tick = rc->tick,
+            .forecast = &g_forecast,
+            .samples = rc->samples ? &g_ulp_samples : NULL,
+            .bounds = &g_ulp_bounds,
+            .background = use_background ? background : NULL,
+        };
+
+        // Cases follow each other in the same framebuffer: the home screen
+        // only redraws the widgets that changed since the previous case. The
+        // timed renders then redraw everything.
+        uint16_t list_len = 0;
+        if (band_rows > 0)
+            list_len = render_bands(ctx, &data, band_rows);
+        else
+            gui_render(ctx, &data);
+
+        char *pbm = NULL;
+        size_t pbm_len = 0;
+        FILE *mem = open_memstream(&pbm, &pbm_len);
+        image_write_pbm(ctx, mem);
+        fclose(mem);
+
+        const uint64_t start = now_ns();
+        for (int run = 0; run < RENDER_RUNS; ++run) {
+            gui_invalidate();
+            if (band_rows > 0)
+                render_bands(ctx, &data, band_rows);
+            else
+                gui_render(ctx, &data);
+        }
+        const double render_us = (now_ns() - start) / 1e3 / RENDER_RUNS;
+
+        char path[512];
+        printf("%-16s %10.1f us", rc->name, render_us);
+        if (band_rows > 0)
+            printf(" %6u B list", list_len);
+#ifdef BITUI_GRAYSCALE
+        long gray = 0;
+        for (size_t b = 0; b < sizeof(framebuffer); ++b)
+            gray += __builtin_popcount((uint8_t)(framebuffer[b] ^ framebuffer_hi[b]));
+        if (gray != 0) {
+            failures++;
+            printf("  FAIL (%ld gray pixels)", gray);
+        }
+#endif
+        if (golden_dir) {
+            snprintf(path, sizeof(path), "%s/%s.pbm", golden_dir, rc->name);
+            const long diff = compare_golden(path, pbm, pbm_len);
+            if (diff == 0) {
+                printf("  ok");
+            } else {
+                failures++;
+                if (diff < 0) printf("  FAIL (no golden %s)", path);
+                else printf("  FAIL (%ld pixels differ)", diff);
+            }
+        }
+        putchar('\n');
+
+        if (update_dir) {
+            snprintf(path, sizeof(path), "%s/%s.pbm", update_dir, rc->name);
+            if (!write_file(path, pbm, pbm_len))
+                failures++;
+        }
+        if (out_dir) {
+            snprintf(path, sizeof(path), "%s/%s.%s", out_dir, rc->name, png ? "png" : "pbm");
+            if (png) {
+                FILE *f = fopen(path, "wb");
+                if (f != NULL) {
+                    image_write_png(ctx, f);
+                    fclose(f);
+                } else {
+                    perror(path);
+                    failures++;
+                }
+            } else if (!write_file(path, pbm, pbm_len)) {
+                failures++;
+            }
+        }
+        free(pbm);
+    }
+    return failures != 0;
+}
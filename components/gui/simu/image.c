@@ -0,0 +1,136 @@
+#include "image.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bitui_point_t image_size(bitui_t ctx) {
+#ifdef BITUI_ROTATION
+    if (ctx->rot & 1)
+        return (bitui_point_t){ .x = ctx->height, .y = ctx->width };
+#endif
+    return (bitui_point_t){ .x = ctx->width, .y = ctx->height };
+}
+
+bool image_pixel(bitui_t ctx, uint16_t x, uint16_t y) {
+    bitui_point_t p = { .x = x, .y = y };
+#ifdef BITUI_ROTATION
+    p = bitui_apply_rot(ctx, p);
+#endif
+#ifdef BITUI_SWAP_XY
+    return ctx->framebuffer[(p.y / 8) * ctx->width + p.x] & (0x80 >> (p.y & 7));
+#else
+    return ctx->framebuffer[p.y * ctx->stride + p.x / 8] & (0x80 >> (p.x & 7));
+#endif
+}
+
+// Packs the row `y`, MSB first. White is 1 unless `black_is_one`.
+static void image_pack_row(bitui_t ctx, uint16_t y, bool black_is_one, uint8_t *row) {
+    const bitui_point_t size = image_size(ctx);
+    for (uint16_t i = 0; i < (size.x - 1) / 8 + 1; ++i)
+        row[i] = 0;
+    for (uint16_t x = 0; x < size.x; ++x) {
+        if (image_pixel(ctx, x, y) != black_is_one)
+            row[x / 8] |= 0x80 >> (x & 7);
+    }
+}
+
+void image_write_pbm(bitui_t ctx, FILE *f) {
+    const bitui_point_t size = image_size(ctx);
+    uint8_t row[(UINT16_MAX - 1) / 8 + 1];
+
+    fprintf(f, "P4\n%u %u\n", size.x, size.y);
+    for (uint16_t y = 0; y < size.y; ++y) {
+        image_pack_row(ctx, y, true, row);
+        fwrite(row, 1, (size.x - 1) / 8 + 1, f);
+    }
+}
+
+/* PNG */
+
+static uint32_t image_crc32(uint32_t crc, const uint8_t *data, size_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *data++;
+        for (int i = 0; i < 8; ++i)
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+    }
+    return ~crc;
+}
+
+static void image_put_u32(uint8_t *out, uint32_t v) {
+    out[0] = v >> 24;
+    out[1] = v >> 16;
+    out[2] = v >> 8;
+    out[3] = v;
+}
+
+static void image_write_chunk(FILE *f, const char type[4], const uint8_t *data, uint32_t len) {
+    uint8_t header[8];
+    image_put_u32(header, len);
+    memcpy(&header[4], type, 4);
+
+    uint8_t crc[4];
+    image_put_u32(crc, image_crc32(image_crc32(0, &header[4], 4), data, len));
+
+    fwrite(header, 1, sizeof(header), f);
+    if (len) fwrite(data, 1, len, f);
+    fwrite(crc, 1, sizeof(crc), f);
+}
+
+void image_write_png(bitui_t ctx, FILE *f) {
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    const bitui_point_t size = image_size(ctx);
+    const size_t row_len = 1 + (size.x - 1) / 8 + 1; // Filter type, then pixels
+    const size_t raw_len = row_len * size.y;
+
+    // Scanlines without filter
+    uint8_t *raw = malloc(raw_len);
+    for (uint16_t y = 0; y < size.y; ++y) {
+        raw[y * row_len] = 0;
+        image_pack_row(ctx, y, false, &raw[y * row_len + 1]);
+    }
+
+    // zlib stream made of stored deflate blocks of at most 65535 bytes
+    const size_t blocks = raw_len / 0xFFFF + 1;
+    uint8_t *zlib = malloc(2 + raw_len + blocks * 5 + 4);
+    size_t z = 0;
+    zlib[z++] = 0x78;
+    zlib[z++] = 0x01;
+    size_t offset = 0;
+    do {
+        const uint16_t len = raw_len - offset > 0xFFFF ? 0xFFFF : raw_len - offset;
+        zlib[z++] = offset + len == raw_len; // BFINAL, BTYPE = 00
+        zlib[z++] = len;
+        zlib[z++] = len >> 8;
+        zlib[z++] = ~len;
+        zlib[z++] = ~len >> 8;
+        memcpy(&zlib[z], &raw[offset], len);
+        z += len;
+        offset += len;
+    } while (offset < raw_len);
+
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < raw_len; ++i) {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    image_put_u32(&zlib[z], b << 16 | a);
+    z += 4;
+
+    uint8_t ihdr[13];
+    image_put_u32(&ihdr[0], size.x);
+    image_put_u32(&ihdr[4], size.y);
+    ihdr[8] = 1;  // Bit depth
+    ihdr[9] = 0;  // Grayscale
+    ihdr[10] = 0; // Deflate
+    ihdr[11] = 0; // Adaptive filtering
+    ihdr[12] = 0; // No interlace
+
+    fwrite(signature, 1, sizeof(signature), f);
+    image_write_chunk(f, "IHDR", ihdr, sizeof(ihdr));
+    image_write_chunk(f, "IDAT", zlib, z);
+    image_write_chunk(f, "IEND", NULL, 0);
+
+    free(zlib);
+    free(raw);
+}
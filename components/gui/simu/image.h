@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "bitui.h"
+
+// Size of the framebuffer as seen by bitui's callers (after rotation).
+bitui_point_t image_size(bitui_t ctx);
+
+// Whether the pixel at `x`, `y` (caller's coordinates) is white.
+bool image_pixel(bitui_t ctx, uint16_t x, uint16_t y);
+
+// Binary PBM (P4), black is 1. Works with any framebuffer layout, so it can
+// also dump a framebuffer read back from the device.
+void image_write_pbm(bitui_t ctx, FILE *f);
+
+// 1-bit grayscale PNG, with uncompressed (stored) deflate blocks.
+void image_write_png(bitui_t ctx, FILE *f);
@@ -7,6 +7,7 @@
 
 #include "gui.h"
 #include "bitui.h"
+#include "fixtures.h"
 
 #define WIN_WIDTH SCREEN_ROWS
 #define WIN_HEIGHT SCREEN_COLS
@@ -45,62 +46,11 @@ int hotreload_load_symbols(void) {
 }
 
 static bitui_t ctx;
-static struct Forecast g_forecast = {
-        .hourly = {
-            .time = {1754784000,1754787600,1754791200,1754794800,1754798400,1754802000,1754805600,1754809200,1754812800,1754816400,1754820000,1754823600,1754827200,1754830800,1754834400,1754838000,1754841600,1754845200,1754848800,1754852400,1754856000,1754859600,1754863200,1754866800,1754870400,1754874000,1754877600,1754881200,1754884800,1754888400,1754892000,1754895600,1754899200,1754902800,1754906400,1754910000,1754913600,1754917200,1754920800,1754924400,1754928000,1754931600,1754935200,1754938800,1754942400,1754946000,1754949600,1754953200},
-            .temperature_2m = {17.3,16.6,16.0,15.5,15.2,15.0,15.2,16.1,17.6,19.7,21.5,23.3,24.8,26.2,27.2,27.9,27.9,27.7,27.1,26.1,25.1,23.8,22.7,21.7,20.9,20.2,19.4,18.6,18.0,17.5,17.8,19.0,20.7,22.9,25.2,27.4,29.2,30.2,31.0,31.6,31.6,31.2,30.5,29.5,28.2,26.8,25.6,24.8},
-            .weather_code = {1,2,3,3,3,3,3,3,3,2,3,3,1,2,1,0,0,3,1,1,1,2,2,2,2,2,2,2,2,1,1,1,2,2,2,3,2,2,1,1,1,0,0,0,0,0,0,0}
-        },
-        .daily = {
-            .time = {1754784000,1754870400},
-            .sunrise = {1754800610,1754887094},
-            .sunset = {1754853293,1754939590}
-        },
-        .updated_at = 1
-    };
-static ulp_sample_ringbuf_t g_ulp_samples = {
-    .start = 0,
-    .count = 32,
-    .items = {
-        { .sht4x_raw_sample.raw_temperature = 100, },
-        { .sht4x_raw_sample.raw_temperature = 200, },
-        { .sht4x_raw_sample.raw_temperature = 300, },
-        { .sht4x_raw_sample.raw_temperature = 400, },
-        { .sht4x_raw_sample.raw_temperature = 500, },
-        { .sht4x_raw_sample.raw_temperature = 600, },
-        { .sht4x_raw_sample.raw_temperature = 700, },
-        { .sht4x_raw_sample.raw_temperature = 800, },
-        { .sht4x_raw_sample.raw_temperature = 900, },
-        { .sht4x_raw_sample.raw_temperature = 1000, },
-        { .sht4x_raw_sample.raw_temperature = 1100, },
-        { .sht4x_raw_sample.raw_temperature = 1200, },
-        { .sht4x_raw_sample.raw_temperature = 1300, },
-        { .sht4x_raw_sample.raw_temperature = 1400, },
-        { .sht4x_raw_sample.raw_temperature = 1500, },
-        { .sht4x_raw_sample.raw_temperature = 1600, },
-        { .sht4x_raw_sample.raw_temperature = 1700, },
-        { .sht4x_raw_sample.raw_temperature = 1800, },
-        { .sht4x_raw_sample.raw_temperature = 1900, },
-        { .sht4x_raw_sample.raw_temperature = 2000, },
-        { .sht4x_raw_sample.raw_temperature = 2100, },
-        { .sht4x_raw_sample.raw_temperature = 2200, },
-        { .sht4x_raw_sample.raw_temperature = 2300, },
-        { .sht4x_raw_sample.raw_temperature = 2400, },
-        { .sht4x_raw_sample.raw_temperature = 2500, },
-        { .sht4x_raw_sample.raw_temperature = 2600, },
-        { .sht4x_raw_sample.raw_temperature = 2700, },
-        { .sht4x_raw_sample.raw_temperature = 2800, },
-        { .sht4x_raw_sample.raw_temperature = 2900, },
-        { .sht4x_raw_sample.raw_temperature = 3000, },
-        { .sht4x_raw_sample.raw_temperature = 3100, },
-        { .sht4x_raw_sample.raw_temperature = 3200, },
-    },
-};
-
 static gui_data_t gui_data = {
     .current_screen = GUI_HOME,
     .forecast = &g_forecast,
-    .samples = &g_ulp_samples
+    .samples = &g_ulp_samples,
+    .bounds = &g_ulp_bounds,
 };
 
 void render_copy(SDL_Texture *texture, bool reload) {
@@ -135,6 +85,9 @@ void render_copy(SDL_Texture *texture, bool reload) {
 int main(int argc, char **argv) {
     (void)argc;
     (void)argv;
+    gui_index_forecast(&g_forecast);
+    ulp_sample_bounds_rebuild(&g_ulp_bounds, &g_ulp_samples);
+
     // SDL init
     if (SDL_Init(SDL_INIT_VIDEO) != 0) {
         SDL_Log("Unable to initialize SDL: %s", SDL_GetError());
@@ -214,6 +167,7 @@ int main(int argc, char **argv) {
                     gui_data.tick = 0;
                     g_forecast.updated_at = 0;
                     g_ulp_samples.count = 0;
+                    g_ulp_bounds = (ulp_sample_bounds_t){ 0 };
                     render_copy(texture, false);
                 } else if (e.key.keysym.scancode == SDL_SCANCODE_T) {
                     const ulp_sample_t newest = g_ulp_samples.items[ringbuf_newest(&g_ulp_samples)];
@@ -222,6 +176,7 @@ int main(int argc, char **argv) {
                     *ringbuf_emplace(&g_ulp_samples) = (ulp_sample_t) {
                         .sht4x_raw_sample.raw_temperature = newest.sht4x_raw_sample.raw_temperature + delta,
                     };
+                    ulp_sample_bounds_push(&g_ulp_bounds, &g_ulp_samples);
                     render_copy(texture, false);
                 }
             }
@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+# Converts an Adafruit GFX font header into bitui glyph runs.
+#
+# Adafruit GFX glyphs are stored as a continuous bitstream: a glyph row can
+# start anywhere inside a byte, which forces the renderer to test every pixel
+# one by one. This tool re-packs every glyph into runs (rows or columns of
+# pixels) starting on a byte boundary so that bitui can blit whole bytes
+# with shifted stores. Pick the layout whose runs follow the framebuffer's
+# byte axis once rotated:
+# - `rows`: each glyph row starts on a new byte, MSB is the leftmost pixel
+# - `cols`: each glyph column starts on a new byte, MSB is the topmost pixel
+#
+# Glyph metrics are kept as is (only `bitmapOffset` changes), so the output
+# is a regular GFXfont named `<Font>Runs` that must be included after the
+# source header (the font fields can reference the source's enums).
+#
+# With `--packed`, the pixels of every glyph (in run order) are stored as
+# alternating lengths of unset and set pixels, starting with unset ones. Each
+# length is a sequence of 4-bit nibbles (MSB first): 15 adds 15 and continues,
+# any other value ends the length. Glyphs that would not shrink, or whose runs
+# are longer than bitui decodes, keep their plain runs and get
+# `BITUI_GLYPH_PLAIN` set in their `bitmapOffset`.
+#
+# Usage: glyphconv.py --runs {rows,cols} [--packed] <input.h> <output.h>
+
+import argparse
+import os
+import re
+import sys
+
+RE_BITMAP = re.compile(r'const\s+uint8_t\s+(\w+)\s*\[\s*\]\s*PROGMEM\s*=\s*\{(.*?)\}\s*;', re.S)
+RE_GLYPHS = re.compile(r'const\s+GFXglyph\s+(\w+)\s*\[\s*\]\s*PROGMEM\s*=\s*\{(.*?)\}\s*;', re.S)
+RE_FONT = re.compile(r'const\s+GFXfont\s+(\w+)\s*PROGMEM\s*=\s*\{(.*?)\}\s*;', re.S)
+RE_GLYPH = re.compile(r'^\s*\{([^}]*)\}\s*,?\s*(?:\}\s*;\s*)?(//.*)?$')
+
+# Flag of plain glyphs in `bitmapOffset`
+PLAIN = 0x8000
+# Longest run bitui_paste_packed_runs decodes (BITUI_PACKED_MAX_RUN)
+PACKED_MAX_RUN = 256
+
+
+def strip_comments(text):
+    text = re.sub(r'/\*.*?\*/', '', text, flags=re.S)
+    return re.sub(r'//[^\n]*', '', text)
+
+
+def parse_font(text):
+    bitmap = RE_BITMAP.search(strip_comments(text))
+    font = RE_FONT.search(strip_comments(text))
+    if bitmap is None or font is None:
+        sys.exit('glyphconv: no GFX bitmap/font found')
+
+    glyphs = []
+    for line in RE_GLYPHS.search(text).group(2).splitlines():
+        if line.lstrip().startswith('//'):
+            continue  # glyph disabled in the source font
+        m = RE_GLYPH.match(line)
+        if m is None:
+            continue
+        fields = [int(v, 0) for v in m.group(1).split(',')]
+        glyphs.append((fields, (m.group(2) or '').strip()))
+
+    data = [int(v, 0) for v in bitmap.group(2).replace('\n', ' ').split(',') if v.strip()]
+    fields = [f.strip() for f in font.group(2).split(',')]
+    return font.group(1), data, glyphs, fields[2:]
+
+
+def glyph_pixels(data, offset, w, h):
+    for i in range(w * h):
+        byte = data[offset + i // 8] if offset + i // 8 < len(data) else 0
+        yield (byte >> (7 - (i & 7))) & 1
+
+
+def pack_runs(pixels, w, h, layout):
+    rows = [pixels[y * w:(y + 1) * w] for y in range(h)]
+    runs = rows if layout == 'rows' else [[rows[y][x] for y in range(h)] for x in range(w)]
+    out = []
+    for run in runs:
+        for i in range(0, len(run), 8):
+            chunk = run[i:i + 8]
+            out.append(sum(bit << (7 - j) for j, bit in enumerate(chunk)))
+    return out
+
+
+def run_order(pixels, w, h, layout):
+    if layout == 'rows':
+        return pixels
+    return [pixels[y * w + x] for x in range(w) for y in range(h)]
+
+
+def pack_lengths(pixels):
+    lengths = []
+    current, n = 0, 0
+    for pixel in pixels:
+        if pixel == current:
+            n += 1
+        else:
+            lengths.append(n)
+            current, n = pixel, 1
+    lengths.append(n)
+
+    nibbles = []
+    for n in lengths:
+        while n >= 15:
+            nibbles.append(15)
+            n -= 15
+        nibbles.append(n)
+    if len(nibbles) & 1:
+        nibbles.append(0)
+    return [nibbles[i] << 4 | nibbles[i + 1] for i in range(0, len(nibbles), 2)]
+
+
+def convert(name, data, glyphs, font_fields, layout, packed, source):
+    bitmap = []
+    out_glyphs = []
+    for (offset, w, h, x_adv, x_off, y_off), comment in glyphs:
+        pixels = list(glyph_pixels(data, offset, w, h))
+        runs = pack_runs(pixels, w, h, layout)
+        stored = len(bitmap)
+        if packed:
+            lengths = pack_lengths(run_order(pixels, w, h, layout))
+            if (h if layout == 'cols' else w) > PACKED_MAX_RUN:
+                stored |= PLAIN  # bitui_paste_packed_runs would draw nothing
+            elif len(lengths) < len(runs):
+                runs = lengths
+            else:
+                stored |= PLAIN
+        out_glyphs.append(((stored, w, h, x_adv, x_off, y_off), comment))
+        bitmap += runs
+    assert len(bitmap) < PLAIN, 'bitmapOffset is 15 bits, the MSB flags plain glyphs'
+
+    runs = name + 'Runs'
+    lines = [
+        '#pragma once',
+        '',
+        '// Generated by glyphconv.py from %s. Do not edit.' % source,
+        '// Glyphs are re-packed as byte-aligned %s (see bitui_paste_runs).' % layout,
+        '',
+        '// Every generated font of a build must share the same layout.',
+        '#define BITUI_GLYPH_RUNS BITUI_RUNS_%s' % layout.upper(),
+        '',
+    ]
+    if packed:
+        lines += [
+            '// Glyphs are packed (see bitui_paste_packed_runs) unless flagged plain.',
+            '#define BITUI_GLYPH_PACKED 1',
+            '#define BITUI_GLYPH_PLAIN 0x%04X' % PLAIN,
+            '',
+        ]
+    lines += [
+        'const uint8_t %sBitmaps[] PROGMEM = {' % runs,
+    ]
+    for i in range(0, len(bitmap), 12):
+        lines.append('  ' + ', '.join('0x%02X' % b for b in bitmap[i:i + 12]) + ',')
+    lines.append('};')
+    lines.append('')
+    lines.append('const GFXglyph %sGlyphs[] PROGMEM = {' % runs)
+    for (fields, comment) in out_glyphs:
+        offset = fields[0] & ~PLAIN
+        offset = 'BITUI_GLYPH_PLAIN | %d' % offset if fields[0] & PLAIN else '%5d' % offset
+        lines.append('  { %s, %3d, %3d, %3d, %4d, %4d },   %s' % ((offset,) + fields[1:] + (comment,)))
+    lines.append('};')
+    lines.append('')
+    lines.append('const GFXfont %s PROGMEM = {' % runs)
+    lines.append('  (uint8_t  *)%sBitmaps,' % runs)
+    lines.append('  (GFXglyph *)%sGlyphs,' % runs)
+    lines.append('  %s };' % ', '.join(font_fields))
+    lines.append('')
+    lines.append('// Approx. %d bytes' % (len(bitmap) + len(out_glyphs) * 7 + 7))
+    return '\n'.join(lines) + '\n'
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--runs', choices=('rows', 'cols'), required=True)
+    parser.add_argument('--packed', action='store_true')
+    parser.add_argument('input')
+    parser.add_argument('output')
+    args = parser.parse_args()
+
+    with open(args.input) as f:
+        name, data, glyphs, font_fields = parse_font(f.read())
+
+    header = convert(name, data, glyphs, font_fields, args.runs, args.packed, os.path.basename(args.input))
+    with open(args.output, 'w') as f:
+        f.write(header)
+
+
+if __name__ == '__main__':
+    main()
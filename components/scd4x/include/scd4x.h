@@ -140,8 +140,9 @@ typedef struct {
     uint16_t raw_temperature;
     uint16_t raw_humidity;
 } scd4x_cmd_read_measurement_t;
-#define SCD4x_RAW_TEMPERATURE_TO_CELCIUS(RawTemperature) (-45.0f + ((float)(RawTemperature) * 175.0f)/UINT16_MAX)
-#define SCD4x_RAW_HUMIDITY_TO_RH(RawHumidity) (((float)(RawHumidity) * 100.0f)/UINT16_MAX)
+// Q16.16, see SENSIRION_Q16_ONE
+#define SCD4x_RAW_TEMPERATURE_TO_CELCIUS_Q16(RawTemperature) (-45 * SENSIRION_Q16_ONE + sensirion_common_q16_scale(175, (RawTemperature)))
+#define SCD4x_RAW_HUMIDITY_TO_RH_Q16(RawHumidity) sensirion_common_q16_scale(100, (RawHumidity))
 
 typedef struct {
     uint16_t status;
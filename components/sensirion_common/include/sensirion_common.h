@@ -16,3 +16,12 @@ uint8_t sensirion_common_calculate_crc8_u16(uint16_t word);
 static inline uint8_t sensirion_common_calculate_crc8_word(sensirion_word_t word) {
     return sensirion_common_calculate_crc8_u16(((uint16_t)word.data[0]) | ((uint16_t)word.data[1]) << 8);
 }
+
+// Q16.16 fixed point, the ESP32-C6 (and its LP core) has no FPU
+#define SENSIRION_Q16_ONE (1 << 16)
+
+// `scale * raw / 65535` in Q16.16, rounded: `x * 65536 / 65535` is `x + x / 65535`
+static inline int32_t sensirion_common_q16_scale(uint32_t scale, uint16_t raw) {
+    const uint32_t x = scale * raw;
+    return x + (x + 65535u / 2) / 65535u;
+}
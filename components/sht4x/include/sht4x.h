@@ -73,16 +73,16 @@ typedef struct {
     uint16_t raw_humidity;
 } sht4x_raw_sample_t;
 
+// Q16.16, see SENSIRION_Q16_ONE
 typedef struct {
-    float temperature_celcius;
-    float relative_humidity;
+    int32_t temperature_celcius_q16;
+    int32_t relative_humidity_q16;
 } sht4x_sample_t;
 
-// TODO: Use fixed point arithmetic
 static inline sht4x_sample_t sht4x_convert(sht4x_raw_sample_t in) {
     sht4x_sample_t sample;
-    sample.temperature_celcius = -45.0f + 175.0f * (float)(in.raw_temperature)/65535.0f;
-    sample.relative_humidity = -6.0f + 125.0f * (float)(in.raw_humidity)/65535.0f;
+    sample.temperature_celcius_q16 = -45 * SENSIRION_Q16_ONE + sensirion_common_q16_scale(175, in.raw_temperature);
+    sample.relative_humidity_q16 = -6 * SENSIRION_Q16_ONE + sensirion_common_q16_scale(125, in.raw_humidity);
     return sample;
 }
 
@@ -4,6 +4,10 @@
 #include "driver/gpio.h"
 #include "sdkconfig.h"
 
+// MAX CLK freq in WRITE mode:  20 Mhz
+// MAX CLK freq in  READ mode: 2.5 Mhz
+#define SSD1680_CLK_FREQ (16 * 1000 * 1000) /* 16Mhz*/
+
 typedef enum {
     SSD168x_UNKNOWN = 0,
     SSD1680 = 1,
@@ -40,7 +44,16 @@ typedef struct {
     ssd1680_rotation_t rotation;
     uint16_t cols;
     uint16_t rows;
+    /// Whole image in the order the controller reads it. NULL when the image
+    /// is only sent in bands, with `ssd1680_flush_band`.
     const uint8_t *framebuffer;
+    /// Optional second plane for SSD1680_REFRESH_GRAY, sent to the RED RAM
+    /// while `framebuffer` goes to the BW RAM. Same layout as `framebuffer`.
+    const uint8_t *framebuffer_red;
+    /// Waveform LUT (Command 0x32) mapping the BW/RED RAM pairs to 4 gray
+    /// levels, specific to the panel. Required by SSD1680_REFRESH_GRAY.
+    const uint8_t *gray_lut;
+    uint8_t gray_lut_len;
 
     spi_host_device_t host; ///< The SPI host used, set before calling `spi_ssd1680_init()`
     gpio_num_t cs_pin;       ///< CS gpio number, set before calling `spi_ssd1680_init()`
@@ -67,10 +80,45 @@ typedef enum {
     SSD1680_REFRESH_FULL,
     SSD1680_REFRESH_FAST,
     SSD1680_REFRESH_PARTIAL,
+    SSD1680_REFRESH_GRAY, // 4 levels from the BW and RED RAM, see ssd1680_config_t.gray_lut
 } ssd1680_refresh_mode_t;
 
 esp_err_t ssd1680_begin_frame(ssd1680_handle_t handle, ssd1680_refresh_mode_t mode);
+/// The flushes queue their SPI transactions and return before they are sent
+/// with DMA: the buffers they read must not change until ssd1680_wait_sent.
+/// ssd1680_begin_frame and ssd1680_end_frame wait for them.
 esp_err_t ssd1680_flush(ssd1680_handle_t handle, ssd1680_rect_t rect);
+/// Writes `rect` from `band`, a buffer that only holds the lines of RAM bytes
+/// crossed by `rect` (bytes along Y when AM is set, along X otherwise) with
+/// the layout of `framebuffer`. `rect` must cover these lines whole.
+/// `band_red` is the matching band of the high bits in SSD1680_REFRESH_GRAY.
+esp_err_t ssd1680_flush_band(ssd1680_handle_t handle, ssd1680_rect_t rect, const uint8_t *band, const uint8_t *band_red);
+/// Without `framebuffer`, ssd1680_begin_frame can't write the previous image
+/// to the RED RAM for SSD1680_REFRESH_PARTIAL: once a frame is refreshed, its
+/// bands are written there again with this.
+esp_err_t ssd1680_flush_previous_band(ssd1680_handle_t handle, ssd1680_rect_t rect, const uint8_t *band);
 esp_err_t ssd1680_end_frame(ssd1680_handle_t handle);
 
+/// Number of SPI transactions queued so far, to wait for with
+/// ssd1680_wait_sent. Wraps around.
+uint32_t ssd1680_queued(ssd1680_handle_t handle);
+/// Blocks the task until the first `count` transactions were sent.
+esp_err_t ssd1680_wait_sent(ssd1680_handle_t handle, uint32_t count);
+
+/// Counters since ssd1680_init, to compare between two calls. Wrap around.
+typedef struct {
+    /// Bytes of the transactions sent, commands included
+    uint32_t bytes_sent;
+    /// Time the calling task was blocked waiting for transactions in flight,
+    /// by any function of the driver. The rest of their transfer time
+    /// overlapped what the task did meanwhile.
+    int64_t blocked_us;
+} ssd1680_stats_t;
+ssd1680_stats_t ssd1680_stats(ssd1680_handle_t handle);
+
+/// Blocks the task until the controller is idle, woken by an interrupt on
+/// BUSY. Uses the task's notification while it waits.
 esp_err_t ssd1680_wait_until_idle(ssd1680_handle_t handle);
+/// Whether the controller is still busy, for example refreshing the panel,
+/// without waiting.
+bool ssd1680_is_busy(ssd1680_handle_t handle);
@@ -2,6 +2,9 @@
 #include <string.h>
 #include "ssd1680.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #define DC_COMMAND(DCPin) (DCPin)
 #define DC_DATA(DCPin) (-(DCPin))
@@ -11,9 +14,8 @@ typedef gpio_num_t SPI_TransactionUserData;
 _Static_assert(sizeof(SPI_TransactionUserData) <= sizeof(((spi_transaction_t*)NULL)->user),
         "SPI_TransactionUserData can be used in spi_transaction_t.user");
 
-// MAX CLK freq in WRITE mode:  20 Mhz
-// MAX CLK freq in  READ mode: 2.5 Mhz
-#define SSD1680_CLK_FREQ 16 * 1000 * 1000 /* 16Mhz*/
+// Transactions in flight at most, see ssd1680_queue
+#define SSD1680_QUEUE_SIZE 8
 
 enum Command : uint8_t {
     CMD_DriverOutputControl = 0x01,
@@ -119,6 +121,7 @@ enum DataEntryMode : uint8_t {
 };
 #define IS_DATA_ENTRY_MODE_LEFT_TO_RIGHT(Mode) ((Mode)&1)
 #define IS_DATA_ENTRY_MODE_TOP_TO_BOTTOM(Mode) ((Mode)&2)
+#define IS_DATA_ENTRY_MODE_Y_FIRST(Mode) ((Mode)&4)
 
 static const enum DataEntryMode ROTATION_TO_DATA_ENTRY[] = {
     [SSD1680_ROT_000] = DATA_ENTRY_LEFT_TO_RIGHT_THEN_TOP_TO_BOTTOM,
@@ -135,6 +138,17 @@ struct ssd1680_context_t {
     };
     spi_device_handle_t spi; // SPI device handle
 
+    // Every transaction is queued from `trans`, in order. The bus stays
+    // acquired while any of them is in flight.
+    spi_transaction_t trans[SSD1680_QUEUE_SIZE];
+    uint32_t queued, sent;
+    bool bus_acquired;
+    ssd1680_stats_t stats;
+
+    // Task in ssd1680_wait_until_idle, notified by ssd1680_busy_isr
+    TaskHandle_t volatile busy_waiter;
+    bool busy_isr_added;
+
     int flush_to_red_ram;
     ssd1680_refresh_mode_t refresh_mode;
 };
@@ -149,6 +163,77 @@ struct Cmd {
     uint8_t data_bytes[4];
 };
 
+// Waits until the oldest transaction in flight was sent.
+static esp_err_t ssd1680_reap(ssd1680_handle_t h) {
+    spi_transaction_t *done;
+    const int64_t start = esp_timer_get_time();
+    esp_err_t err = spi_device_get_trans_result(h->spi, &done, portMAX_DELAY);
+    h->stats.blocked_us += esp_timer_get_time() - start;
+    if (err != ESP_OK) return err;
+
+    h->stats.bytes_sent += done->length / 8;
+    h->sent++;
+    if (h->sent == h->queued && h->bus_acquired) {
+        spi_device_release_bus(h->spi);
+        h->bus_acquired = false;
+    }
+    return ESP_OK;
+}
+
+// Queues a copy of `t` and returns without waiting for it to be sent: its
+// buffer must not change until then, see ssd1680_wait_sent.
+static esp_err_t ssd1680_queue(ssd1680_handle_t h, const spi_transaction_t *t) {
+    esp_err_t err;
+    if (h->queued - h->sent == SSD1680_QUEUE_SIZE) {
+        err = ssd1680_reap(h);
+        if (err != ESP_OK) return err;
+    }
+
+    if (!h->bus_acquired) {
+        // Acquire bus required to use SPI_TRANS_CS_KEEP_ACTIVE
+        err = spi_device_acquire_bus(h->spi, portMAX_DELAY);
+        if (err != ESP_OK) return err;
+        h->bus_acquired = true;
+    }
+
+    spi_transaction_t *slot = &h->trans[h->queued % SSD1680_QUEUE_SIZE];
+    *slot = *t;
+    err = spi_device_queue_trans(h->spi, slot, portMAX_DELAY);
+    if (err != ESP_OK) {
+        if (h->sent == h->queued) {
+            spi_device_release_bus(h->spi);
+            h->bus_acquired = false;
+        }
+        return err;
+    }
+    h->queued++;
+    return ESP_OK;
+}
+
+uint32_t ssd1680_queued(ssd1680_handle_t h) {
+    return h->queued;
+}
+
+ssd1680_stats_t ssd1680_stats(ssd1680_handle_t h) {
+    return h->stats;
+}
+
+esp_err_t ssd1680_wait_sent(ssd1680_handle_t h, uint32_t count) {
+    if (h->spi == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    // Counts wrap around
+    while ((int32_t)(count - h->sent) > 0) {
+        esp_err_t err = ssd1680_reap(h);
+        if (err != ESP_OK) return err;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t ssd1680_drain(ssd1680_handle_t h) {
+    return ssd1680_wait_sent(h, h->queued);
+}
+
 #define ssd1680_cmd_write(Handle, CmdId, ...) __ssd1680_cmd_write((Handle), (struct Cmd){ \
         .id = (CmdId), \
         .data_len = sizeof((uint8_t[]){ __VA_ARGS__ }), \
@@ -174,7 +259,7 @@ static esp_err_t __ssd1680_cmd_write(ssd1680_handle_t h, const struct Cmd cmd) {
         .flags = SPI_TRANS_USE_TXDATA | (has_data ? SPI_TRANS_CS_KEEP_ACTIVE : 0)
     };
 
-    ret = spi_device_polling_transmit(h->spi, &command);
+    ret = ssd1680_queue(h, &command);
 
     /* Send DATA if there is any */
     if (!has_data || ret != ESP_OK) return ret;
@@ -187,9 +272,30 @@ static esp_err_t __ssd1680_cmd_write(ssd1680_handle_t h, const struct Cmd cmd) {
         .flags = SPI_TRANS_USE_TXDATA
     };
 
-    ret = spi_device_polling_transmit(h->spi, &payload);
+    return ssd1680_queue(h, &payload);
+}
 
-    return ret;
+// Same as ssd1680_cmd_write, for commands with more data than a transaction can hold inline
+static esp_err_t ssd1680_cmd_write_buffer(ssd1680_handle_t h, enum Command id, const uint8_t *data, size_t data_len) {
+    esp_err_t ret;
+
+    spi_transaction_t command = {
+        .length = sizeof(uint8_t) * 8,
+        .tx_data[0] = id,
+        .user = (void*)DC_COMMAND(h->cfg.dc_pin),
+        .flags = SPI_TRANS_USE_TXDATA | SPI_TRANS_CS_KEEP_ACTIVE
+    };
+
+    ret = ssd1680_queue(h, &command);
+    if (ret != ESP_OK) return ret;
+
+    spi_transaction_t payload = {
+        .length = sizeof(uint8_t) * 8 * data_len,
+        .tx_buffer = data,
+        .user = (void*)DC_DATA(h->cfg.dc_pin),
+    };
+
+    return ssd1680_queue(h, &payload);
 }
 
 static bool ssd1680_check_controller_resolution(ssd1680_controller_t controller, uint16_t cols, uint16_t rows) {
@@ -212,6 +318,19 @@ static IRAM_ATTR void ssd1680_spi_pre_transfer_callback(spi_transaction_t *t)
     gpio_set_level(DC_PIN(user_data), DC_LEVEL(user_data));
 }
 
+// BUSY is low: wakes the waiting task. The interrupt is on the level, so it
+// also fires when BUSY fell before it was enabled, and is disabled here until
+// the next wait.
+static void ssd1680_busy_isr(void *arg)
+{
+    ssd1680_handle_t h = arg;
+    BaseType_t woken = pdFALSE;
+    gpio_intr_disable(h->cfg.busy_pin);
+    if (h->busy_waiter != NULL)
+        vTaskNotifyGiveFromISR(h->busy_waiter, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
 esp_err_t ssd1680_init(const ssd1680_config_t *cfg, ssd1680_handle_t* out_handle)
 {
     esp_err_t err = ESP_OK;
@@ -223,10 +342,6 @@ esp_err_t ssd1680_init(const ssd1680_config_t *cfg, ssd1680_handle_t* out_handle
         ESP_LOGE(TAG, "interrupt cannot be used on SPI1 host.");
         return ESP_ERR_INVALID_ARG;
     }
-    if (cfg->framebuffer == NULL) {
-        ESP_LOGE(TAG, "Framebuffer is required.");
-        return ESP_ERR_INVALID_ARG;
-    }
     if (!ssd1680_check_controller_resolution(cfg->controller, cfg->cols, cfg->rows)) {
         ESP_LOGE(TAG, "Resolution not supported by the current controller.");
         return ESP_ERR_INVALID_ARG;
@@ -237,6 +352,12 @@ esp_err_t ssd1680_init(const ssd1680_config_t *cfg, ssd1680_handle_t* out_handle
         return ESP_ERR_NO_MEM;
 
     ctx->mut_cfg = *cfg;
+    ctx->spi = NULL;
+    ctx->queued = ctx->sent = 0;
+    ctx->bus_acquired = false;
+    ctx->stats = (ssd1680_stats_t){ 0 };
+    ctx->busy_waiter = NULL;
+    ctx->busy_isr_added = false;
     ctx->refresh_mode = SSD1680_REFRESH_FULL;
     ctx->flush_to_red_ram = 0;
 
@@ -245,7 +366,7 @@ esp_err_t ssd1680_init(const ssd1680_config_t *cfg, ssd1680_handle_t* out_handle
         .clock_speed_hz = SSD1680_CLK_FREQ,
         .spics_io_num = cfg->cs_pin,
         .flags = SPI_DEVICE_HALFDUPLEX | SPI_DEVICE_3WIRE,
-        .queue_size = 1,
+        .queue_size = SSD1680_QUEUE_SIZE,
         .pre_cb = cfg->dc_pin == -1 ? NULL : ssd1680_spi_pre_transfer_callback
     };
 
@@ -264,8 +385,20 @@ esp_err_t ssd1680_init(const ssd1680_config_t *cfg, ssd1680_handle_t* out_handle
         .pin_bit_mask = BIT64(ctx->cfg.busy_pin),
         .mode = GPIO_MODE_INPUT,
         .pull_down_en = true,
+        .intr_type = GPIO_INTR_LOW_LEVEL,
     };
     gpio_config(&busy_cfg);
+    // Only enabled while a task waits, see ssd1680_wait_until_idle
+    gpio_intr_disable(ctx->cfg.busy_pin);
+
+    // Other drivers may have installed the service already
+    err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE)
+        goto cleanup;
+    err = gpio_isr_handler_add(ctx->cfg.busy_pin, ssd1680_busy_isr, ctx);
+    if (err != ESP_OK)
+        goto cleanup;
+    ctx->busy_isr_added = true;
 
     /* 2. Set Initial Configuration
      *    • Define SPI interface to communicate with MCU
@@ -277,10 +410,6 @@ esp_err_t ssd1680_init(const ssd1680_config_t *cfg, ssd1680_handle_t* out_handle
     gpio_set_level(ctx->cfg.reset_pin, 1);
     vTaskDelay(10 / portTICK_PERIOD_MS);
 
-    // Acquire bus required
-    err = spi_device_acquire_bus(ctx->spi, portMAX_DELAY);
-    if (err != ESP_OK) goto cleanup;
-
     err = ssd1680_cmd_write(ctx, CMD_SWReset);
     if (err != ESP_OK) goto cleanup;
     err = ssd1680_wait_until_idle(ctx);
@@ -345,13 +474,18 @@ esp_err_t ssd1680_init(const ssd1680_config_t *cfg, ssd1680_handle_t* out_handle
         if (err != ESP_OK) goto cleanup;
     }
 
-    spi_device_release_bus(ctx->spi);
+    err = ssd1680_drain(ctx);
+    if (err != ESP_OK) goto cleanup;
     *out_handle = ctx;
     return ESP_OK;
 
 cleanup:
+    if (ctx->busy_isr_added)
+        gpio_isr_handler_remove(ctx->cfg.busy_pin);
     if (ctx->spi) {
-        spi_device_release_bus(ctx->spi);
+        ssd1680_drain(ctx);
+        if (ctx->bus_acquired)
+            spi_device_release_bus(ctx->spi);
         spi_bus_remove_device(ctx->spi);
         ctx->spi = NULL;
     }
@@ -365,9 +499,6 @@ esp_err_t ssd1680_deinit(ssd1680_handle_t *ctx) {
 
     esp_err_t err;
 
-    err = spi_device_acquire_bus((*ctx)->spi, portMAX_DELAY);
-    if (err != ESP_OK) goto cleanup;
-
     /* 6. Power Off
      *    • Deep sleep by Command 0x10
      */
@@ -376,10 +507,13 @@ esp_err_t ssd1680_deinit(ssd1680_handle_t *ctx) {
         err = ssd1680_cmd_write(*ctx, CMD_DeepSleepMode, deep_sleep_mode);
     }
 
-cleanup:
-    spi_device_release_bus((*ctx)->spi);
+    const esp_err_t drained = ssd1680_drain(*ctx);
+    if (err == ESP_OK) err = drained;
+    if ((*ctx)->bus_acquired)
+        spi_device_release_bus((*ctx)->spi);
     spi_bus_remove_device((*ctx)->spi);
     (*ctx)->spi = NULL;
+    gpio_isr_handler_remove((*ctx)->cfg.busy_pin);
 
     free(*ctx);
     *ctx = NULL;
@@ -387,19 +521,14 @@ cleanup:
 }
 
 esp_err_t ssd1680_set_rotation(ssd1680_handle_t h, ssd1680_rotation_t rotation) {
-    esp_err_t err;
-
-    // Acquire bus required to use SPI_TRANS_CS_KEEP_ACTIVE
-    err = spi_device_acquire_bus(h->spi, portMAX_DELAY);
-    if (err != ESP_OK) goto defer;
+    // The windows in flight were computed for the previous rotation
+    esp_err_t err = ssd1680_drain(h);
+    if (err != ESP_OK) return err;
 
     err = ssd1680_cmd_write(h, CMD_DataEntryModeSetting, ROTATION_TO_DATA_ENTRY[rotation]);
-    if (err != ESP_OK) goto defer;
+    if (err != ESP_OK) return err;
     h->mut_cfg.rotation = rotation;
-
-defer:
-    spi_device_release_bus(h->spi);
-    return err;
+    return ssd1680_drain(h);
 }
 
 #define SWAP(A, B) do { \
@@ -408,19 +537,53 @@ defer:
     B = tmp; \
 } while (0)
 
-esp_err_t ssd1680_flush(ssd1680_handle_t h, ssd1680_rect_t rect) {
-    if (h->spi == NULL)
-        return ESP_ERR_INVALID_ARG;
-    if (rect.x > h->cfg.cols || rect.x + rect.w > h->cfg.cols)
-        return ESP_ERR_INVALID_ARG;
-    if (rect.y > h->cfg.rows || rect.y + rect.h > h->cfg.rows)
-        return ESP_ERR_INVALID_ARG;
+// Position of a window in the order the controller reads the RAM in the
+// current data entry mode: lines of bytes along X (or Y when AM is set) that
+// follow each other. The window covers the same contiguous chunk of each line
+// it crosses.
+typedef struct {
+    size_t line_len;
+    uint16_t line_first, line_last;
+    uint16_t chunk_first;
+    size_t chunk_len;
+} ssd1680_stream_window_t;
+
+static ssd1680_stream_window_t ssd1680_stream_window(ssd1680_handle_t h, ssd1680_rect_t rect) {
+    const enum DataEntryMode data_entry_mode =
+        ROTATION_TO_DATA_ENTRY[h->cfg.rotation];
+    const uint16_t stride = (h->cfg.cols - 1) / 8 + 1;
+
+    uint16_t x_first = rect.x / 8;
+    uint16_t x_last = (rect.x + rect.w - 1) / 8;
+    if (!IS_DATA_ENTRY_MODE_LEFT_TO_RIGHT(data_entry_mode)) {
+        SWAP(x_first, x_last);
+        x_first = stride - 1 - x_first;
+        x_last = stride - 1 - x_last;
+    }
 
-    esp_err_t err;
+    uint16_t y_first = rect.y;
+    uint16_t y_last = rect.y + rect.h - 1;
+    if (!IS_DATA_ENTRY_MODE_TOP_TO_BOTTOM(data_entry_mode)) {
+        SWAP(y_first, y_last);
+        y_first = h->cfg.rows - 1 - y_first;
+        y_last = h->cfg.rows - 1 - y_last;
+    }
 
-    // Acquire bus required to use SPI_TRANS_CS_KEEP_ACTIVE
-    err = spi_device_acquire_bus(h->spi, portMAX_DELAY);
-    if (err != ESP_OK) goto defer;
+    const bool y_first_mode = IS_DATA_ENTRY_MODE_Y_FIRST(data_entry_mode);
+    return (ssd1680_stream_window_t){
+        .line_len = y_first_mode ? h->cfg.rows : stride,
+        .line_first = y_first_mode ? x_first : y_first,
+        .line_last = y_first_mode ? x_last : y_last,
+        .chunk_first = y_first_mode ? y_first : x_first,
+        .chunk_len = (y_first_mode ? y_last : x_last) - (y_first_mode ? y_first : x_first) + 1,
+    };
+}
+
+// Queues the `rect` window of `framebuffer` for the RAM selected by
+// `write_ram_cmd`. With `band`, `framebuffer` only holds the lines (in the
+// stream order) crossed by `rect`, which must cover them whole.
+static esp_err_t ssd1680_write_window(ssd1680_handle_t h, ssd1680_rect_t rect, enum Command write_ram_cmd, const uint8_t *framebuffer, bool band) {
+    esp_err_t err;
 
     const enum DataEntryMode data_entry_mode =
         ROTATION_TO_DATA_ENTRY[h->cfg.rotation];
@@ -434,11 +597,11 @@ esp_err_t ssd1680_flush(ssd1680_handle_t h, ssd1680_rect_t rect) {
 
         err = ssd1680_cmd_write(h, CMD_SetRAM_Counter_X, start_x);
         if (err != ESP_OK)
-            goto defer;
+            return err;
 
         err = ssd1680_cmd_write(h, CMD_SetRAM_StartEnd_X, start_x, end_x);
         if (err != ESP_OK)
-            goto defer;
+            return err;
     }
 
     {
@@ -450,60 +613,110 @@ esp_err_t ssd1680_flush(ssd1680_handle_t h, ssd1680_rect_t rect) {
         err = ssd1680_cmd_write(h, CMD_SetRAM_Counter_Y,
                 start_y & 0xff, start_y >> 8);
         if (err != ESP_OK)
-            goto defer;
+            return err;
 
         err = ssd1680_cmd_write(h, CMD_SetRAM_StartEnd_Y,
                 start_y & 0xff, start_y >> 8,
                 end_y & 0xff, end_y >> 8);
         if (err != ESP_OK)
-            goto defer;
+            return err;
     }
 
-    /* Send framebuffer row by row */
+    /* Send the window */
 
     spi_transaction_t command = {
         .length = sizeof(uint8_t) * 8,
-        .tx_data[0] = h->flush_to_red_ram ? CMD_WriteRAM_RED : CMD_WriteRAM_BW,
+        .tx_data[0] = write_ram_cmd,
         .user = (void*)DC_COMMAND(h->cfg.dc_pin),
         .flags = SPI_TRANS_USE_TXDATA | SPI_TRANS_CS_KEEP_ACTIVE
     };
 
-    err = spi_device_polling_transmit(h->spi, &command);
-    if (err != ESP_OK) goto defer;
+    err = ssd1680_queue(h, &command);
+    if (err != ESP_OK) return err;
 
-    if (rect.x == 0 && rect.y == 0 && rect.w == h->cfg.cols && rect.h == h->cfg.rows) {
-        spi_transaction_t payload = {
-            .length = h->cfg.rows * h->cfg.cols,
-            .tx_buffer = h->cfg.framebuffer,
-            .user = (void*)DC_DATA(h->cfg.dc_pin),
-            .flags = SPI_TRANS_CS_KEEP_ACTIVE
-        };
+    {
+        const ssd1680_stream_window_t window = ssd1680_stream_window(h, rect);
+        // Offset of `framebuffer` in the stream
+        const size_t origin = band ? window.line_first * window.line_len : 0;
 
-        err = spi_device_polling_transmit(h->spi, &payload);
-    } else {
-        const size_t row_stride = (h->cfg.cols - 1) / 8 + 1;
         spi_transaction_t payload = {
-            .length = h->cfg.cols, // TODO: Incorrect when rect is a smaller window
-            .tx_buffer = h->cfg.framebuffer,
+            .length = window.chunk_len * 8,
             .user = (void*)DC_DATA(h->cfg.dc_pin),
             .flags = SPI_TRANS_CS_KEEP_ACTIVE
         };
 
-        for (uint16_t row = 0; row < h->cfg.rows; ++row) { // TODO: Incorrect when rect is a smaller window
-            payload.tx_buffer = &h->cfg.framebuffer[row * row_stride];
-            if (row + 1 == h->cfg.rows) payload.flags = 0;
-
-            err = spi_device_polling_transmit(h->spi, &payload);
-            if (err != ESP_OK)
-                goto defer;
+        if (window.chunk_len == window.line_len) {
+            // Whole lines follow each other
+            payload.length = (window.line_last - window.line_first + 1) * window.line_len * 8;
+            payload.tx_buffer = &framebuffer[window.line_first * window.line_len - origin];
+            payload.flags = 0;
+
+            err = ssd1680_queue(h, &payload);
+        } else {
+            // One transaction per line, queued back to back
+            for (uint16_t line = window.line_first; line <= window.line_last; ++line) {
+                payload.tx_buffer = &framebuffer[line * window.line_len + window.chunk_first - origin];
+                if (line == window.line_last) payload.flags = 0;
+
+                err = ssd1680_queue(h, &payload);
+                if (err != ESP_OK)
+                    return err;
+            }
         }
     }
-
-defer:
-    spi_device_release_bus(h->spi);
     return err;
 }
 
+static bool ssd1680_check_rect(ssd1680_handle_t h, ssd1680_rect_t rect) {
+    if (rect.x > h->cfg.cols || rect.x + rect.w > h->cfg.cols)
+        return false;
+    if (rect.y > h->cfg.rows || rect.y + rect.h > h->cfg.rows)
+        return false;
+    return rect.w != 0 && rect.h != 0;
+}
+
+esp_err_t ssd1680_flush(ssd1680_handle_t h, ssd1680_rect_t rect) {
+    if (h->spi == NULL || h->cfg.framebuffer == NULL)
+        return ESP_ERR_INVALID_ARG;
+    if (!ssd1680_check_rect(h, rect))
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t err = ssd1680_write_window(h, rect,
+            h->flush_to_red_ram ? CMD_WriteRAM_RED : CMD_WriteRAM_BW, h->cfg.framebuffer, false);
+    if (err != ESP_OK || h->refresh_mode != SSD1680_REFRESH_GRAY || h->flush_to_red_ram)
+        return err;
+
+    // The high bits of the gray levels go to the RED RAM
+    return ssd1680_write_window(h, rect, CMD_WriteRAM_RED, h->cfg.framebuffer_red, false);
+}
+
+// Bands are made of whole lines of the stream order, see ssd1680_stream_window
+static bool ssd1680_check_band(ssd1680_handle_t h, ssd1680_rect_t rect, const uint8_t *band) {
+    if (h->spi == NULL || band == NULL || !ssd1680_check_rect(h, rect))
+        return false;
+    const ssd1680_stream_window_t window = ssd1680_stream_window(h, rect);
+    return window.chunk_len == window.line_len;
+}
+
+esp_err_t ssd1680_flush_band(ssd1680_handle_t h, ssd1680_rect_t rect, const uint8_t *band, const uint8_t *band_red) {
+    if (!ssd1680_check_band(h, rect, band))
+        return ESP_ERR_INVALID_ARG;
+    if (h->refresh_mode == SSD1680_REFRESH_GRAY && band_red == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t err = ssd1680_write_window(h, rect, CMD_WriteRAM_BW, band, true);
+    if (err != ESP_OK || h->refresh_mode != SSD1680_REFRESH_GRAY)
+        return err;
+
+    return ssd1680_write_window(h, rect, CMD_WriteRAM_RED, band_red, true);
+}
+
+esp_err_t ssd1680_flush_previous_band(ssd1680_handle_t h, ssd1680_rect_t rect, const uint8_t *band) {
+    if (!ssd1680_check_band(h, rect, band))
+        return ESP_ERR_INVALID_ARG;
+    return ssd1680_write_window(h, rect, CMD_WriteRAM_RED, band, true);
+}
+
 esp_err_t ssd1680_begin_frame(ssd1680_handle_t h, ssd1680_refresh_mode_t new_mode) {
     esp_err_t err;
 
@@ -511,17 +724,26 @@ esp_err_t ssd1680_begin_frame(ssd1680_handle_t h, ssd1680_refresh_mode_t new_mod
     err = ssd1680_wait_until_idle(h);
     if (err != ESP_OK) return err;
 
-    if (h->refresh_mode != new_mode) {
-        // Acquire bus required to use SPI_TRANS_CS_KEEP_ACTIVE
-        err = spi_device_acquire_bus(h->spi, portMAX_DELAY);
-        if (err != ESP_OK) goto defer;
+    if (new_mode == SSD1680_REFRESH_GRAY && ((h->cfg.framebuffer != NULL && h->cfg.framebuffer_red == NULL) || h->cfg.gray_lut == NULL)) {
+        ESP_LOGE(TAG, "Gray levels require a RED RAM framebuffer and a LUT.");
+        return ESP_ERR_INVALID_STATE;
+    }
 
+    if (h->refresh_mode != new_mode) {
+        const bool uses_red_ram = new_mode == SSD1680_REFRESH_PARTIAL || new_mode == SSD1680_REFRESH_GRAY;
         err = ssd1680_cmd_write(h, CMD_DisplayUpdateControl1,
-                ((new_mode == SSD1680_REFRESH_PARTIAL ? RAM_Normal : RAM_BypassAs0) << 4) // RED RAM
+                ((uses_red_ram ? RAM_Normal : RAM_BypassAs0) << 4) // RED RAM
                     | RAM_Normal, // BW RAM
                 SSD1685_RES_168x384,
             );
-        if (err != ESP_OK) goto defer;
+        if (err != ESP_OK) return err;
+
+        if (new_mode == SSD1680_REFRESH_GRAY) {
+            // The OTP waveforms only know black and white: each BW/RED RAM
+            // pair selects one of the 4 voltage sequences of the custom LUT.
+            err = ssd1680_cmd_write_buffer(h, CMD_WriteLUT, h->cfg.gray_lut, h->cfg.gray_lut_len);
+            if (err != ESP_OK) return err;
+        }
 
         if (new_mode == SSD1680_REFRESH_FAST) {
             // E-ink particles slower at lower temperatures and quicker at
@@ -532,49 +754,50 @@ esp_err_t ssd1680_begin_frame(ssd1680_handle_t h, ssd1680_refresh_mode_t new_mod
 
             // Set the display's current temperature to +110 C (0x6E)
             err = ssd1680_cmd_write(h, CMD_WriteTemperatureRegister, 0x6E);
-            if (err != ESP_OK) goto defer;
+            if (err != ESP_OK) return err;
 
             // Load LUT with Display Mode 1 matching the new temperature value.
             err = ssd1680_cmd_write(h, CMD_DisplayUpdateControl2, 0x91);
-            if (err != ESP_OK) goto defer;
+            if (err != ESP_OK) return err;
 
             // Trigger the loading of the LUT while the user is drawing UI.
             err = ssd1680_cmd_write(h, CMD_MasterActivationUpdateSeq);
-            if (err != ESP_OK) goto defer;
+            if (err != ESP_OK) return err;
         }
 
-        spi_device_release_bus(h->spi); // ssd1680_flush locks the SPI bus again
-
         if (new_mode == SSD1680_REFRESH_PARTIAL) {
             // More detailed explanation: https://github.com/adafruit/Adafruit_EPD/issues/50#issuecomment-2692179474
             // The partial refresh or Display Mode 2 will update the pixels
             // depending on the diff between the BW ram (new) and RED ram (old).
 
-            // Write previous framebuffer to RED RAM
-            h->flush_to_red_ram = 1;
-            err = ssd1680_flush(h, (ssd1680_rect_t){ .x = 0, .y = 0, .w = h->cfg.cols, .h = h->cfg.rows });
-            h->flush_to_red_ram = 0;
+            // Write previous framebuffer to RED RAM. Without one, the
+            // caller does it band by band with ssd1680_flush_previous_band.
+            if (h->cfg.framebuffer != NULL) {
+                h->flush_to_red_ram = 1;
+                err = ssd1680_flush(h, (ssd1680_rect_t){ .x = 0, .y = 0, .w = h->cfg.cols, .h = h->cfg.rows });
+                h->flush_to_red_ram = 0;
+                if (err != ESP_OK) return err;
+            }
         }
+
+        // The caller draws the next frame into the framebuffer sent to the
+        // RED RAM, and ssd1680_is_busy must see the LUT load
+        err = ssd1680_drain(h);
+        if (err != ESP_OK) return err;
     }
 
     h->refresh_mode = new_mode;
     return err;
-defer:
-   spi_device_release_bus(h->spi);
-   return err;
 }
 
 esp_err_t ssd1680_end_frame(ssd1680_handle_t h) {
     esp_err_t err;
 
-    // Wait for any previous operation to finish (example: SSD1680_REFRESH_FAST LUT load).
+    // Wait for any previous operation to finish (example: SSD1680_REFRESH_FAST
+    // LUT load), and for the windows in flight
     err = ssd1680_wait_until_idle(h);
     if (err != ESP_OK) return err;
 
-    // Acquire bus required to use SPI_TRANS_CS_KEEP_ACTIVE
-    err = spi_device_acquire_bus(h->spi, portMAX_DELAY);
-    if (err != ESP_OK) goto defer;
-
     uint8_t display_update_control2 = 0x01;
     switch (h->refresh_mode) {
         case SSD1680_REFRESH_FAST:
@@ -586,6 +809,11 @@ esp_err_t ssd1680_end_frame(ssd1680_handle_t h) {
             // TODO: Official example from GoodDisplay uses 0xF4 -> need to investigate
             display_update_control2 = 0xF7;
             break;
+        case SSD1680_REFRESH_GRAY:
+            // Same as SSD1680_REFRESH_FAST: keep the LUT written by
+            // ssd1680_begin_frame instead of loading one from the OTP.
+            display_update_control2 = 0xC7;
+            break;
         case SSD1680_REFRESH_PARTIAL:
             // TODO: Official example from GoodDisplay uses 0xDF -> need to investigate
             // Same as 0xF7 but uses Display mode 2
@@ -594,22 +822,36 @@ esp_err_t ssd1680_end_frame(ssd1680_handle_t h) {
     }
 
     err = ssd1680_cmd_write(h, CMD_DisplayUpdateControl2, display_update_control2);
-    if (err != ESP_OK) goto defer;
+    if (err != ESP_OK) return err;
 
     err = ssd1680_cmd_write(h, CMD_MasterActivationUpdateSeq);
+    if (err != ESP_OK) return err;
 
-defer:
-    spi_device_release_bus(h->spi);
-    return err;
+    // Sent before returning, so that ssd1680_is_busy sees the refresh
+    return ssd1680_drain(h);
 }
 
 esp_err_t ssd1680_wait_until_idle(ssd1680_handle_t ctx) {
     if (ctx->spi == NULL)
         return ESP_ERR_INVALID_ARG;
 
-    // TODO: Use FreeRTOS to eliminate the busy loop
+    // BUSY only follows the commands once they were sent
+    esp_err_t err = ssd1680_drain(ctx);
+    if (err != ESP_OK) return err;
+
+    if (!gpio_get_level(ctx->cfg.busy_pin))
+        return ESP_OK;
+
+    // Sleeps until ssd1680_busy_isr, instead of polling through a refresh
+    ctx->busy_waiter = xTaskGetCurrentTaskHandle();
     while (gpio_get_level(ctx->cfg.busy_pin)) {
-        vTaskDelay(1 / portTICK_PERIOD_MS);
+        gpio_intr_enable(ctx->cfg.busy_pin);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
     }
+    ctx->busy_waiter = NULL;
     return ESP_OK;
 }
+
+bool ssd1680_is_busy(ssd1680_handle_t ctx) {
+    return ctx->spi != NULL && gpio_get_level(ctx->cfg.busy_pin);
+}
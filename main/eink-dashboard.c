@@ -48,7 +48,47 @@ static EventGroupHandle_t s_wifi_event_group;
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT      BIT1
 
-static uint8_t framebuffer[SCREEN_STRIDE * SCREEN_ROWS];
+// Rows of the gui (panel columns) rendered at once, a multiple of 8. 0 keeps
+// the whole frame in RAM; otherwise the frame is rendered and sent one band
+// at a time, for panels whose framebuffer doesn't fit beside Wi-Fi and TLS:
+// the 480x800 one would take 3 x 48 KB, its two bands take 2 x 4.8 KB.
+#ifndef GUI_BAND_ROWS
+#if GUI_PANEL == GUI_PANEL_397
+#define GUI_BAND_ROWS 48
+#else
+#define GUI_BAND_ROWS 0
+#endif
+#endif
+
+#if GUI_BAND_ROWS == 0
+static uint8_t framebuffer[SCREEN_STRIDE * SCREEN_ROWS] __attribute__((aligned(4)));
+// Copy of the framebuffer as it was last sent to the panel. The panel loses
+// its RAM in deep sleep, so the first frame after boot is always sent whole.
+static uint8_t flushed_framebuffer[sizeof(framebuffer)] __attribute__((aligned(4)));
+static bool has_flushed_framebuffer = false;
+static uint8_t damage[BITUI_DAMAGE_SIZE(SCREEN_ROWS, SCREEN_COLS)];
+// What never changes on the home screen, drawn once by the GUI
+static uint8_t gui_background[GUI_BACKGROUND_SIZE] __attribute__((aligned(4)));
+#else
+_Static_assert(GUI_BAND_ROWS % 8 == 0, "Bands hold whole framebuffer bytes");
+#define GUI_BANDS ((SCREEN_COLS - 1) / GUI_BAND_ROWS + 1)
+
+static uint8_t framebuffer[GUI_BAND_ROWS / 8 * SCREEN_ROWS] __attribute__((aligned(4)));
+// A band renders into one buffer while the previous one is sent from the other
+static uint8_t spare_framebuffer[sizeof(framebuffer)] __attribute__((aligned(4)));
+static uint8_t *const band_buffers[2] = { framebuffer, spare_framebuffer };
+// ssd1680_queued once the last band of each buffer was queued
+static uint32_t band_buffer_sent[2];
+static uint8_t *const damage = NULL;
+static uint8_t *const gui_background = NULL;
+// Hash of each band as it was last sent to the panel, 0 for never sent
+static uint32_t band_hashes[GUI_BANDS];
+// The frame is recorded once, then replayed in each band
+static uint8_t display_list_ops[GUI_LIST_SIZE] __attribute__((aligned(2)));
+static bitui_list_t display_list = { .ops = display_list_ops, .capacity = sizeof(display_list_ops) };
+// gui_frame_key of the frame in the display list, 0 when there is none
+static uint32_t display_list_key = 0;
+#endif
 
 static void *static_reserve_hourly_uint64(void *cursor, size_t i) {
     return i < FORECAST_HOURLY_POINT_COUNT ? ((uint64_t*)cursor) + i : NULL;
@@ -272,7 +312,7 @@ void init_devices() {
 
         .rows = SCREEN_ROWS,
         .cols = SCREEN_COLS,
-        .framebuffer = framebuffer
+        .framebuffer = GUI_BAND_ROWS == 0 ? framebuffer : NULL
     }, &ssd1680_handle);
     int64_t end = esp_timer_get_time();
     ESP_LOGD(TAG, "ssd1680_init took %lldus\n", end-start);
@@ -430,6 +470,7 @@ static void decode_weather(esp_tls_t *tls_session) {
                 ESP_LOGD(TAG, "\ttime[%d] = %lld\tsunrise[%d] = %lld\tsunset[%d] = %lld,", i, gui_data.forecast.daily.time[i], i, gui_data.forecast.daily.sunrise[i], i, gui_data.forecast.daily.sunset[i]);
             }
             ESP_LOGD(TAG, "]");*/
+            gui_index_forecast(&g_forecast);
             g_forecast.updated_at = 1;
             //time(&g_forecast.updated_at);
         }
@@ -438,39 +479,365 @@ static void decode_weather(esp_tls_t *tls_session) {
     }
 }
 
-static void gui_tick(bitui_t ctx) {
+// bitui draws with BITUI_SWAP_XY into the framebuffer that the controller
+// reads in SSD1680_ROT_090: the byte row i is the column of bytes
+// SCREEN_STRIDE - 1 - i of the panel, and bitui's x is the panel's row.
+static ssd1680_rect_t damage_to_panel_rect(bitui_rect_t window) {
+    const uint16_t first_byte = window.y / 8;
+    const uint16_t last_byte = (window.y + window.h - 1) / 8;
+    return (ssd1680_rect_t){
+        .x = (SCREEN_STRIDE - 1 - last_byte) * 8,
+        .w = (last_byte - first_byte + 1) * 8,
+        .y = window.x,
+        .h = window.w,
+    };
+}
+
+#if GUI_BAND_ROWS == 0
+/* Animations
+ *
+ * The frames of the region reported by gui_animation are rendered once. While
+ * the rest of the screen stays the same, a tick only copies its frame back and
+ * sends that region.
+ */
+
+#define GUI_ANIMATION_FRAMES 8
+#define GUI_ANIMATION_FRAME_SIZE 128
+
+static gui_animation_t animation;
+static bool has_animation_frames = false;
+static uint8_t animation_frames[GUI_ANIMATION_FRAMES][GUI_ANIMATION_FRAME_SIZE];
+static uint8_t animation_shown;
+
+static bool animation_fits(const gui_animation_t *next) {
+    if (next->frames == 0 || next->frames > GUI_ANIMATION_FRAMES || next->rect.w == 0 || next->rect.h == 0)
+        return false;
+    const uint16_t rows = (next->rect.y + next->rect.h - 1) / 8 - next->rect.y / 8 + 1;
+    return (uint32_t)rows * next->rect.w <= GUI_ANIMATION_FRAME_SIZE;
+}
+
+// Copies the byte rows of the region between `buffer` and `frame`
+static void animation_copy(uint8_t *buffer, uint8_t *frame, bool to_buffer) {
+    const bitui_rect_t rect = animation.rect;
+    for (uint16_t row = rect.y / 8; row <= (rect.y + rect.h - 1) / 8; ++row, frame += rect.w) {
+        uint8_t *line = buffer + row * SCREEN_ROWS + rect.x;
+        if (to_buffer)
+            memcpy(line, frame, rect.w);
+        else
+            memcpy(frame, line, rect.w);
+    }
+}
+
+// Renders every frame of `next` and keeps its region
+static void animation_capture(bitui_t ctx, const gui_animation_t *next) {
+    int64_t start = esp_timer_get_time();
+    animation = *next;
+    gui_data_t frame_data = gui_data;
+    for (uint8_t frame = 0; frame < animation.frames; ++frame) {
+        frame_data.tick = frame;
+        gui_render(ctx, &frame_data);
+        animation_copy(framebuffer, animation_frames[frame], false);
+    }
+    has_animation_frames = true;
+    int64_t end = esp_timer_get_time();
+    ESP_LOGD(TAG, "Capturing %d animation frames took %lldus\n", animation.frames, end-start);
+}
+
+// Sends the frame of the animation for the current tick, unless it is shown.
+// Returns the number of pixels sent.
+static uint32_t animation_step(void) {
+    const uint8_t frame = gui_data.tick % animation.frames;
+    if (frame == animation_shown)
+        return 0;
+
+    animation_copy(framebuffer, animation_frames[frame], true);
+    animation_copy(flushed_framebuffer, animation_frames[frame], true);
+    // The framebuffer was drawn without gui_render: the retained widgets it
+    // remembers may no longer match its pixels
+    gui_invalidate();
+    ESP_ERROR_CHECK(ssd1680_flush(ssd1680_handle, damage_to_panel_rect(animation.rect)));
+    animation_shown = frame;
+    return (uint32_t)animation.rect.w * animation.rect.h;
+}
+
+// Renders the frame and sends the windows that changed since the last one.
+// Returns the number of pixels sent.
+static uint32_t gui_render_frame(bitui_t ctx) {
     esp_err_t ret;
     int64_t start, end;
-    static int updates = 0;
-
-    start = esp_timer_get_time();
-    ret = ssd1680_begin_frame(ssd1680_handle, updates == 0 ? SSD1680_REFRESH_FULL : SSD1680_REFRESH_PARTIAL);
-    end = esp_timer_get_time();
-    ESP_LOGD(TAG, "ssd1680_begin_frame(%d) took %lldus\n", updates, end-start);
-    ESP_ERROR_CHECK(ret);
 
-    if (updates == 0) updates = 5;
-    updates--;
+    // The screen on the panel was the last one rendered: when only its
+    // animation moves, the region alone is sent
+    gui_animation_t next;
+    if (has_flushed_framebuffer && gui_animation(&gui_data, &next) && animation_fits(&next)) {
+        const bool same = has_animation_frames && next.still == animation.still
+            && next.frames == animation.frames && memcmp(&next.rect, &animation.rect, sizeof(next.rect)) == 0;
+        if (same)
+            return animation_step();
+        animation_capture(ctx, &next);
+    }
 
     start = esp_timer_get_time();
     gui_render(ctx, &gui_data);
     end = esp_timer_get_time();
     ESP_LOGD(TAG, "gui_render took %lldus\n", end-start);
 
+    // Redrawn pixels are often identical: only send what actually changed
+    start = esp_timer_get_time();
+    if (has_flushed_framebuffer) {
+        bitui_diff_damage(ctx, flushed_framebuffer);
+    } else {
+        memcpy(flushed_framebuffer, framebuffer, sizeof(framebuffer));
+        has_flushed_framebuffer = true;
+    }
+    end = esp_timer_get_time();
+    ESP_LOGD(TAG, "bitui_diff_damage took %lldus\n", end-start);
+
     start = esp_timer_get_time();
-    ret = ssd1680_flush(ssd1680_handle, (ssd1680_rect_t){
-        .x = 0, .y = 0,
-        .w = SCREEN_COLS, .h = SCREEN_ROWS
+    int windows = 0;
+    uint32_t area = 0;
+    bitui_rect_t window;
+    while (bitui_next_damage(ctx, &window)) {
+        ret = ssd1680_flush(ssd1680_handle, damage_to_panel_rect(window));
+        ESP_ERROR_CHECK(ret);
+        windows++;
+        area += (uint32_t)window.w * window.h;
+    }
+    end = esp_timer_get_time();
+    ESP_LOGD(TAG, "ssd1680_flush of %d windows took %lldus\n", windows, end-start);
+
+    if (has_animation_frames)
+        animation_shown = gui_data.tick % animation.frames;
+    return area;
+}
+#else
+static uint32_t band_hash(const uint8_t *buffer) {
+    // FNV-1a, never 0 so that 0 can mean "never sent"
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(framebuffer); ++i)
+        hash = (hash ^ buffer[i]) * 16777619u;
+    return hash ? hash : 1;
+}
+
+static uint16_t band_rows(int band) {
+    const uint16_t y = band * GUI_BAND_ROWS;
+    return SCREEN_COLS - y < GUI_BAND_ROWS ? SCREEN_COLS - y : GUI_BAND_ROWS;
+}
+
+// SPI transfer time spent rendering the next bands instead of waiting, since
+// the last tick was accounted. Between overlap_begin and overlap_end, the
+// transfers not hidden by rendering are the time the driver blocked.
+static int64_t flush_overlap_us;
+static ssd1680_stats_t overlap_start;
+
+static void overlap_begin(void) {
+    overlap_start = ssd1680_stats(ssd1680_handle);
+}
+
+// Waits for every band queued since overlap_begin
+static void overlap_end(void) {
+    ESP_ERROR_CHECK(ssd1680_wait_sent(ssd1680_handle, ssd1680_queued(ssd1680_handle)));
+    const ssd1680_stats_t end = ssd1680_stats(ssd1680_handle);
+    const int64_t transfer_us = (int64_t)(end.bytes_sent - overlap_start.bytes_sent) * 8 * 1000000 / SSD1680_CLK_FREQ;
+    const int64_t blocked_us = end.blocked_us - overlap_start.blocked_us;
+    ESP_LOGD(TAG, "Flushing took %lldus, blocked %lldus\n", transfer_us, blocked_us);
+    if (transfer_us > blocked_us)
+        flush_overlap_us += transfer_us - blocked_us;
+}
+
+// Renders `band` into the buffer `buffer`, once the band last sent from it
+// left. Sends only read the buffer, so this overlaps the other one's.
+static uint32_t render_band(bitui_t ctx, int band, int buffer) {
+    ESP_ERROR_CHECK(ssd1680_wait_sent(ssd1680_handle, band_buffer_sent[buffer]));
+    ctx->framebuffer = band_buffers[buffer];
+    bitui_set_band(ctx, band * GUI_BAND_ROWS, band_rows(band));
+    if (!display_list.overflow)
+        bitui_replay(ctx, &display_list, (bitui_rect_t){ .x = 0, .y = 0, .w = SCREEN_ROWS, .h = SCREEN_COLS });
+    else
+        gui_render(ctx, &gui_data);
+    bitui_set_band(ctx, 0, 0);
+    return band_hash(ctx->framebuffer);
+}
+
+static ssd1680_rect_t band_to_panel_rect(int band) {
+    return damage_to_panel_rect((bitui_rect_t){
+        .x = 0, .y = band * GUI_BAND_ROWS, .w = SCREEN_ROWS, .h = band_rows(band),
     });
+}
+
+// Records the frame when the gui data changed, then replays it one band at a
+// time and sends the bands whose hash changed. Returns the number of pixels
+// sent.
+static uint32_t gui_render_frame(bitui_t ctx) {
+    int64_t start = esp_timer_get_time();
+    const uint32_t key = gui_frame_key(&gui_data);
+    if (key == 0 || key != display_list_key) {
+        bitui_list_reset(&display_list);
+        ctx->list = &display_list;
+        gui_render(ctx, &gui_data);
+        ctx->list = NULL;
+        display_list_key = display_list.overflow ? 0 : key;
+        if (display_list.overflow)
+            ESP_LOGW(TAG, "Display list overflow, rendering every band from scratch\n");
+    } else {
+        // The same frame as the last one: done once every band was sent
+        int band = 0;
+        while (band < GUI_BANDS && band_hashes[band] != 0)
+            band++;
+        if (band == GUI_BANDS)
+            return 0;
+    }
+
+    int bands = 0;
+    uint32_t area = 0;
+    int buffer = 0;
+    overlap_begin();
+    for (int band = 0; band < GUI_BANDS; ++band) {
+        const uint32_t hash = render_band(ctx, band, buffer);
+        if (hash == band_hashes[band])
+            continue;
+
+        // Queued: the next band renders into the other buffer meanwhile
+        ESP_ERROR_CHECK(ssd1680_flush_band(ssd1680_handle, band_to_panel_rect(band), band_buffers[buffer], NULL));
+        band_buffer_sent[buffer] = ssd1680_queued(ssd1680_handle);
+        buffer ^= 1;
+        // Marked as sent once also in the RED RAM, see gui_flush_previous_frame
+        band_hashes[band] = 0;
+        bands++;
+        area += (uint32_t)SCREEN_ROWS * band_rows(band);
+    }
+    overlap_end();
+    int64_t end = esp_timer_get_time();
+    ESP_LOGD(TAG, "Rendered %d bands, sent %d, in %lldus\n", GUI_BANDS, bands, end-start);
+    return area;
+}
+
+// Partial refreshes compare the BW RAM to the previous image in the RED RAM,
+// which ssd1680_begin_frame can't write without a whole framebuffer. The bands
+// of the last refreshed frame, still in the display list, are replayed again
+// into it by the next tick: ticks don't run while the panel refreshes (see
+// vTask_gui_tick), instead of waiting for it here. Returns false when the
+// RED RAM can't hold the previous image: the next refresh must be full.
+static bool red_ram_pending = false;
+
+static bool gui_flush_previous_frame(bitui_t ctx) {
+    if (!red_ram_pending)
+        return true;
+    red_ram_pending = false;
+    // gui_render would draw the current data, not the previous image. A full
+    // refresh doesn't read the RED RAM, and sends the bands again.
+    if (display_list.overflow)
+        return false;
+
+    // Only waits when called out of vTask_gui_tick
+    ESP_ERROR_CHECK(ssd1680_wait_until_idle(ssd1680_handle));
+    int buffer = 0;
+    overlap_begin();
+    for (int band = 0; band < GUI_BANDS; ++band) {
+        if (band_hashes[band] != 0)
+            continue;
+        band_hashes[band] = render_band(ctx, band, buffer);
+        ESP_ERROR_CHECK(ssd1680_flush_previous_band(ssd1680_handle, band_to_panel_rect(band), band_buffers[buffer]));
+        band_buffer_sent[buffer] = ssd1680_queued(ssd1680_handle);
+        buffer ^= 1;
+    }
+    // Sent before this frame's SSD1680_REFRESH_PARTIAL compares to them
+    overlap_end();
+    return true;
+}
+#endif
+
+/* Frame scheduling
+ *
+ * Partial refreshes are quick but leave ghosts, that a full refresh cleans.
+ * Every partially refreshed pixel spends some of a ghosting budget, and the
+ * next frame after it ran out is a full refresh. A frame that changes most
+ * of the screen (a new screen) uses the fast full refresh instead: it is
+ * quicker than a partial one of that size, and leaves less ghosting.
+ *
+ * Ticks that come while the panel is still refreshing are skipped: the next
+ * one draws everything that changed in between, in one refresh.
+ */
+
+#define SCREEN_AREA ((uint32_t)SCREEN_ROWS * SCREEN_COLS)
+// Pixels partially refreshed before the next full refresh
+#define GUI_GHOSTING_BUDGET (4 * SCREEN_AREA)
+// Damage from which a frame uses SSD1680_REFRESH_FAST
+#define GUI_FAST_AREA (SCREEN_AREA / 2)
+// Ghosting left by a fast refresh
+#define GUI_FAST_GHOSTING (SCREEN_AREA / 2)
+
+typedef struct {
+    uint32_t ticks;
+    uint32_t missed_deadlines; // Ticks that started late, the previous one took too long
+    uint32_t coalesced;        // Ticks skipped while the panel was busy
+    uint32_t unchanged;        // Frames without damage, not refreshed
+    uint32_t refreshes[SSD1680_REFRESH_GRAY + 1]; // Per ssd1680_refresh_mode_t
+    int64_t longest_tick_us;
+    // Estimated SPI transfer time spent rendering bands instead of waiting. 0
+    // with a whole framebuffer: it is rendered before any of it is sent.
+    int64_t overlap_us;
+} gui_scheduler_metrics_t;
+
+static gui_scheduler_metrics_t gui_metrics;
+// The first frame is a full refresh: the panel shows anything
+static uint32_t gui_ghosting = GUI_GHOSTING_BUDGET;
+
+static void gui_log_metrics(void) {
+    ESP_LOGI(TAG, "gui: %lu ticks, %lu late, %lu coalesced, %lu unchanged, refreshes %lu full %lu fast %lu partial, longest tick %lldus, flush overlap %lldus",
+        gui_metrics.ticks, gui_metrics.missed_deadlines, gui_metrics.coalesced, gui_metrics.unchanged,
+        gui_metrics.refreshes[SSD1680_REFRESH_FULL], gui_metrics.refreshes[SSD1680_REFRESH_FAST],
+        gui_metrics.refreshes[SSD1680_REFRESH_PARTIAL], gui_metrics.longest_tick_us, gui_metrics.overlap_us);
+}
+
+static void gui_tick(bitui_t ctx) {
+    esp_err_t ret;
+    int64_t start, end;
+
+#if GUI_BAND_ROWS != 0
+    if (!gui_flush_previous_frame(ctx))
+        gui_ghosting = GUI_GHOSTING_BUDGET;
+#endif
+
+    // Prepared before rendering: switching to PARTIAL writes the image still
+    // in the framebuffer to the RED RAM, as the previous one
+    ssd1680_refresh_mode_t mode = gui_ghosting >= GUI_GHOSTING_BUDGET ? SSD1680_REFRESH_FULL : SSD1680_REFRESH_PARTIAL;
+    start = esp_timer_get_time();
+    ret = ssd1680_begin_frame(ssd1680_handle, mode);
     end = esp_timer_get_time();
-    ESP_LOGD(TAG, "ssd1680_flush took %lldus\n", end-start);
+    ESP_LOGD(TAG, "ssd1680_begin_frame(%d) took %lldus\n", mode, end-start);
     ESP_ERROR_CHECK(ret);
 
+    const uint32_t area = gui_render_frame(ctx);
+    if (area == 0) {
+        // Same image: the refresh would only cost time and energy
+        ESP_LOGD(TAG, "Frame unchanged, refresh skipped\n");
+        gui_metrics.unchanged++;
+        return;
+    }
+    if (mode == SSD1680_REFRESH_PARTIAL && area >= GUI_FAST_AREA) {
+        // Only sets the waveform, the BW RAM holds the whole frame
+        mode = SSD1680_REFRESH_FAST;
+        ESP_ERROR_CHECK(ssd1680_begin_frame(ssd1680_handle, mode));
+    }
+    switch (mode) {
+    case SSD1680_REFRESH_FULL:    gui_ghosting = 0; break;
+    case SSD1680_REFRESH_FAST:    gui_ghosting = GUI_FAST_GHOSTING; break;
+    default:                      gui_ghosting += area; break;
+    }
+    gui_metrics.refreshes[mode]++;
+
     start = esp_timer_get_time();
     ret = ssd1680_end_frame(ssd1680_handle);
     end = esp_timer_get_time();
     ESP_LOGD(TAG, "ssd1680_end_frame took %lldus\n", end-start);
     ESP_ERROR_CHECK(ret);
+
+#if GUI_BAND_ROWS != 0
+    red_ram_pending = true;
+    gui_metrics.overlap_us += flush_overlap_us;
+    flush_overlap_us = 0;
+#endif
 }
 
 #define TZ_EUROPE_PARIS "CET-1CEST,M3.5.0,M10.5.0/3"
@@ -482,6 +849,7 @@ void vTask_gui_tick(void * pvParameters)
         .height = SCREEN_COLS,
         .stride = SCREEN_STRIDE,
         .framebuffer = framebuffer,
+        .damage = damage,
         //.rot = BITUI_ROT_090,
         .color = true,
     };
@@ -500,20 +868,29 @@ void vTask_gui_tick(void * pvParameters)
     for (;;)
     {
         xWasDelayed = xTaskDelayUntil(&xLastWakeTime, xFrequency);
-        ESP_LOGD(TAG, "!!!!!!!!!!!!!!!!!!!!!! xWasDelayed = %d\n", xWasDelayed);
+        gui_metrics.ticks++;
+        // Not delayed: the deadline already passed when the last tick ended
+        if (xWasDelayed == pdFALSE)
+            gui_metrics.missed_deadlines++;
 
         /*if (memcmp((void*)&old_gui_data, (void*)&gui_data, sizeof(gui_data)) != 0) {
             gui_data.tick = 0;
             old_gui_data = gui_data;
         }*/
         gui_data.tick++;
+        if (ssd1680_is_busy(ssd1680_handle)) {
+            // Still refreshing: the next tick draws this one's changes too
+            gui_metrics.coalesced++;
+            continue;
+        }
+
         start = esp_timer_get_time();
         gui_tick(ctx);
         end = esp_timer_get_time();
 
         ESP_LOGD(TAG, "gui_tick took %lldus\n", end-start);
-        // Perform action here. xWasDelayed value can be used to determine
-        // whether a deadline was missed if the code here took too long.
+        if (end - start > gui_metrics.longest_tick_us)
+            gui_metrics.longest_tick_us = end - start;
     }
 }
 
@@ -546,10 +923,13 @@ static void load_weather_data(void) {
         vTaskDelete(xTask_gui_tick);
         xTask_gui_tick = NULL;
     }
+    gui_log_metrics();
 }
 
 static ulp_sample_ringbuf_t local_copy;
 _Static_assert(sizeof(ulp_sample_ringbuf) == sizeof(local_copy));
+static ulp_sample_bounds_t local_bounds;
+_Static_assert(sizeof(ulp_sample_bounds) == sizeof(local_bounds));
 
 void load_sensors_data(void) {
     scd4x_cmd(scd41_dev_handle, SCD4x_WAKE_UP);
@@ -569,13 +949,18 @@ void load_sensors_data(void) {
 
     scd4x_cmd_read_measurement_t measurement = { 0 };
     ESP_ERROR_CHECK(scd4x_get(scd41_dev_handle, &measurement));
-    ESP_LOGI(TAG, "SCD4x Measurement: \tCO2 %hu ppm\t TEMP %.1f C \t RH %.1f %", measurement.co2_ppm, SCD4x_RAW_TEMPERATURE_TO_CELCIUS(measurement.raw_temperature), SCD4x_RAW_HUMIDITY_TO_RH(measurement.raw_humidity));
+    char temperature[GUI_FIXED_LEN], humidity[GUI_FIXED_LEN];
+    gui_format_fixed(temperature, SCD4x_RAW_TEMPERATURE_TO_CELCIUS_Q16(measurement.raw_temperature), 16, 1);
+    gui_format_fixed(humidity, SCD4x_RAW_HUMIDITY_TO_RH_Q16(measurement.raw_humidity), 16, 1);
+    ESP_LOGI(TAG, "SCD4x Measurement: \tCO2 %hu ppm\t TEMP %s C \t RH %s %", measurement.co2_ppm, temperature, humidity);
 
     ESP_ERROR_CHECK(sht4x_cmd(sht41_dev_handle, SHT4x_MEASURE_HIGH_PRECISION));
     sht4x_result_t sht4x_res;
     ESP_ERROR_CHECK(sht4x_read(sht41_dev_handle, &sht4x_res));
     sht4x_sample_t sht4x_sample = sht4x_convert(sht4x_res.sample);
-    ESP_LOGI(TAG, "SCD4x Measurement: \t TEMP %.1f C \t RH %.1f %", sht4x_sample.temperature_celcius, sht4x_sample.relative_humidity);
+    gui_format_fixed(temperature, sht4x_sample.temperature_celcius_q16, 16, 1);
+    gui_format_fixed(humidity, sht4x_sample.relative_humidity_q16, 16, 1);
+    ESP_LOGI(TAG, "SCD4x Measurement: \t TEMP %s C \t RH %s %", temperature, humidity);
 
     ESP_LOGI(TAG, "Powering down SCD4x...");
     ESP_ERROR_CHECK(scd4x_cmd(scd41_dev_handle, SCD4x_POWER_DOWN));
@@ -585,6 +970,7 @@ void load_sensors_data(void) {
         .co2_ppm = measurement.co2_ppm,
         .sht4x_raw_sample = sht4x_res.sample
     };
+    ulp_sample_bounds_push(&local_bounds, &local_copy);
 
     ESP_ERROR_CHECK(i2c_master_bus_rm_device(scd41_dev_handle));
     ESP_ERROR_CHECK(i2c_master_bus_rm_device(sht41_dev_handle));
@@ -642,6 +1028,7 @@ void app_main(void)
 {
     esp_err_t ret;
     gui_data.forecast = &g_forecast;
+    gui_data.background = gui_background;
 
     init_devices();
     init_rtc_io();
@@ -653,12 +1040,15 @@ void app_main(void)
     case ESP_SLEEP_WAKEUP_ULP:
     case ESP_SLEEP_WAKEUP_TIMER: {
             memcpy(&local_copy, (uint8_t*)&ulp_sample_ringbuf, sizeof(local_copy));
+            memcpy(&local_bounds, (uint8_t*)&ulp_sample_bounds, sizeof(local_bounds));
             gui_data.samples = &local_copy;
+            gui_data.bounds = &local_bounds;
             bitui_handle = (bitui_ctx_t){
                 .width = SCREEN_ROWS,
                 .height = SCREEN_COLS,
                 .stride = SCREEN_STRIDE,
                 .framebuffer = framebuffer,
+                .damage = damage,
                 .color = true,
             };
             //load_sensors_data();
@@ -670,6 +1060,7 @@ void app_main(void)
         ulp_lp_core_stop();
         load_sensors_data();
         gui_data.samples = &local_copy;
+        gui_data.bounds = &local_bounds;
         load_weather_data();
         config_ld2410s(); // LD2410s should have be initialized by now
         start_ulp_program();
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdbool.h>
+
 #include "ringbuf.h"
 
 typedef uint64_t ulp_sample_flags_t;
@@ -27,4 +29,94 @@ typedef struct [[gnu::packed]] {
 _Static_assert(sizeof(ulp_sample_t) == 14);
 typedef RingBufStatic(ulp_sample_t, 32) ulp_sample_ringbuf_t;
 
+// Running min/max of the raw sensor values (the conversions are increasing),
+// over the ULP_SAMPLE_BOUNDS_WINDOW newest samples and over the older ones of
+// a ulp_sample_ringbuf_t. Updated in O(1) amortized by ulp_sample_bounds_push
+// after every push.
+//
+// Each bound is a monotonic deque: the samples that become the min (or max)
+// once the older ones leave. As the ring holds 32 samples, a deque is the
+// bitmask of the ages of its samples, the newest sample being bit 0, and its
+// front is the highest bit.
+#define ULP_SAMPLE_BOUNDS_WINDOW 15
+_Static_assert(ringbuf_cap((ulp_sample_ringbuf_t*)0) == 32, "Bounds are 32-bit masks");
+
+typedef enum {
+    ULP_SAMPLE_RAW_TEMPERATURE = 0,
+    ULP_SAMPLE_RAW_HUMIDITY,
+    ULP_SAMPLE_CO2_PPM,
+    ULP_SAMPLE_METRIC_COUNT,
+} ulp_sample_metric_t;
+
+typedef struct {
+    struct {
+        uint32_t window_min, window_max;
+        uint32_t older_min, older_max;
+    } metrics[ULP_SAMPLE_METRIC_COUNT];
+} ulp_sample_bounds_t;
+
+static inline uint16_t ulp_sample_metric(const volatile ulp_sample_t *sample, ulp_sample_metric_t metric) {
+    switch (metric) {
+    case ULP_SAMPLE_RAW_TEMPERATURE: return sample->sht4x_raw_sample.raw_temperature;
+    case ULP_SAMPLE_RAW_HUMIDITY:    return sample->sht4x_raw_sample.raw_humidity;
+    default:                         return sample->co2_ppm;
+    }
+}
+
+static inline uint16_t ulp_sample_metric_at_age(const volatile ulp_sample_ringbuf_t *ring, ulp_sample_metric_t metric, uint8_t age) {
+    return ulp_sample_metric(&ring->items[ringbuf_newest_nth(ring, age)], metric);
+}
+
+// Adds the sample of age `age` to `deque`, whose samples are all older. The
+// ones that can't be the bound while this sample is there are popped first.
+static inline uint32_t ulp_sample_deque_push(uint32_t deque, const volatile ulp_sample_ringbuf_t *ring, ulp_sample_metric_t metric, uint8_t age, bool max) {
+    const uint16_t value = ulp_sample_metric_at_age(ring, metric, age);
+    uint32_t rest;
+    while ((rest = deque >> (age + 1)) != 0) {
+        const uint8_t back = age + 1 + __builtin_ctz(rest);
+        const uint16_t back_value = ulp_sample_metric_at_age(ring, metric, back);
+        if (max ? back_value > value : back_value < value)
+            break;
+        deque &= ~(1u << back);
+    }
+    return deque | (1u << age);
+}
+
+// Call after every ringbuf_emplace on `ring`, once the sample is written.
+static inline void ulp_sample_bounds_push(volatile ulp_sample_bounds_t *bounds, const volatile ulp_sample_ringbuf_t *ring) {
+    const uint32_t window_mask = (1u << ULP_SAMPLE_BOUNDS_WINDOW) - 1;
+    for (int m = 0; m < ULP_SAMPLE_METRIC_COUNT; m++) {
+        // Every sample gets one push older, the one that was overwritten
+        // (age 32) is shifted out
+        uint32_t window_min = bounds->metrics[m].window_min << 1;
+        uint32_t window_max = bounds->metrics[m].window_max << 1;
+        uint32_t older_min = bounds->metrics[m].older_min << 1;
+        uint32_t older_max = bounds->metrics[m].older_max << 1;
+
+        // The sample that left the window
+        if (ring->count > ULP_SAMPLE_BOUNDS_WINDOW) {
+            older_min = ulp_sample_deque_push(older_min, ring, m, ULP_SAMPLE_BOUNDS_WINDOW, false);
+            older_max = ulp_sample_deque_push(older_max, ring, m, ULP_SAMPLE_BOUNDS_WINDOW, true);
+        }
+        bounds->metrics[m].window_min = ulp_sample_deque_push(window_min & window_mask, ring, m, 0, false);
+        bounds->metrics[m].window_max = ulp_sample_deque_push(window_max & window_mask, ring, m, 0, true);
+        bounds->metrics[m].older_min = older_min;
+        bounds->metrics[m].older_max = older_max;
+    }
+}
+
+// Value at the front of `deque`, which must not be empty
+static inline uint16_t ulp_sample_deque_front(uint32_t deque, const volatile ulp_sample_ringbuf_t *ring, ulp_sample_metric_t metric) {
+    return ulp_sample_metric_at_age(ring, metric, 31 - __builtin_clz(deque));
+}
+
+// Recomputes `bounds` for samples that were not pushed with
+// ulp_sample_bounds_push, by pushing them again from the oldest.
+static inline void ulp_sample_bounds_rebuild(ulp_sample_bounds_t *bounds, const ulp_sample_ringbuf_t *ring) {
+    *bounds = (ulp_sample_bounds_t){ 0 };
+    ulp_sample_ringbuf_t prefix = *ring;
+    for (prefix.count = 1; prefix.count <= ring->count; prefix.count++)
+        ulp_sample_bounds_push(bounds, &prefix);
+}
+
 #define ULP_WAKEUP_PERIOD_US (1 /* min */ * 60 /* s */ * 1000 /* ms */ * 1000 /* us */)
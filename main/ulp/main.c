@@ -14,6 +14,7 @@
 #include "common.h"
 
 volatile ulp_sample_ringbuf_t sample_ringbuf;
+volatile ulp_sample_bounds_t sample_bounds;
 volatile uint64_t last_lp_core_wakeup_rtc_ticks;
 
 // Saves about 800 bytes of RTC SLOW RAM by avoiding the software 64-bit
@@ -81,6 +82,7 @@ static inline void collect_measurement(void) {
     uint64_t rtc_timer_val = ulp_lp_core_lp_timer_get_cycle_count();
     cur_sample.flags = ulp_sample_flags_from_parts(rtc_timer_val, sht4x_err & 0xff, scd4x_err & 0xff);
     *ringbuf_emplace(&sample_ringbuf) = cur_sample;
+    ulp_sample_bounds_push(&sample_bounds, &sample_ringbuf);
 
     // Wake up main processor
     if (ulp_lp_core_gpio_get_level(PIN_LD2410S_OCCUPIED)) {